@@ -0,0 +1,173 @@
+// Forced alignment throughput benchmark
+//
+// Aligns a list of utterances with one aligner per thread sharing one
+// model, utterances are distributed over the threads round-robin and all
+// audio is loaded upfront. The list has a WAV file and its transcript on
+// each line:
+//
+//   utt1.wav hello world
+//
+// Prints a JSON line per thread count with the number of utterances, the
+// failed alignments, utterances per second and the real-time factor. With
+// -v the alignment result of every utterance is printed as well.
+//
+// Usage: bench_align [-t 1,2,4] [-v] am_dir lang_dir config list.txt
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Utterance {
+    string path;
+    string text;
+    vector<short> audio;
+};
+
+static vector<Utterance> utterances;
+static float sample_rate;
+static bool verbose;
+static mutex output_mutex;
+
+static double Now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool ReadWav(Utterance *utt)
+{
+    unsigned char header[44];
+    FILE *wavin = fopen(utt->path.c_str(), "rb");
+
+    if (!wavin || fread(header, 1, 44, wavin) != 44) {
+        fprintf(stderr, "Can't read %s\n", utt->path.c_str());
+        if (wavin)
+            fclose(wavin);
+        return false;
+    }
+    float rate = header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
+    if (sample_rate != 0 && rate != sample_rate) {
+        fprintf(stderr, "Sample rate of %s differs from the first file\n", utt->path.c_str());
+        fclose(wavin);
+        return false;
+    }
+    sample_rate = rate;
+
+    short buf[4096];
+    size_t nread;
+    while ((nread = fread(buf, sizeof(short), 4096, wavin)) > 0)
+        utt->audio.insert(utt->audio.end(), buf, buf + nread);
+    fclose(wavin);
+    return true;
+}
+
+static bool ReadList(const char *path)
+{
+    ifstream list(path);
+    string line;
+
+    if (!list) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return false;
+    }
+    while (getline(list, line)) {
+        size_t split = line.find_first_of(" \t");
+        if (line.empty() || split == string::npos)
+            continue;
+        Utterance utt;
+        utt.path = line.substr(0, split);
+        utt.text = line.substr(split + 1);
+        if (!ReadWav(&utt))
+            return false;
+        utterances.push_back(utt);
+    }
+    return !utterances.empty();
+}
+
+static void Worker(VoskAligner *aligner, int thread_index, int num_threads, int *failed)
+{
+    for (size_t i = thread_index; i < utterances.size(); i += num_threads) {
+        const Utterance &utt = utterances[i];
+        const char *result = vosk_aligner_align_s(aligner, utt.text.c_str(), utt.audio.data(), utt.audio.size());
+        if (!result)
+            (*failed)++;
+        if (verbose) {
+            lock_guard<mutex> lock(output_mutex);
+            printf("{\"file\": \"%s\", \"result\": %s}\n", utt.path.c_str(), result ? result : "null");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    string thread_list = "1,2,4";
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:v")) != -1) {
+        switch (opt) {
+        case 't': thread_list = optarg; break;
+        case 'v': verbose = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 1,2,4] [-v] am_dir lang_dir config list.txt\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 4) {
+        fprintf(stderr, "Usage: %s [-t 1,2,4] [-v] am_dir lang_dir config list.txt\n", argv[0]);
+        return 1;
+    }
+    if (!ReadList(argv[optind + 3]))
+        return 1;
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+
+    double audio_sec = 0;
+    for (size_t i = 0; i < utterances.size(); i++)
+        audio_sec += utterances[i].audio.size() / sample_rate;
+
+    size_t pos = 0;
+    while (pos < thread_list.size()) {
+        int num_threads = atoi(thread_list.c_str() + pos);
+        pos = thread_list.find(',', pos);
+        pos = pos == string::npos ? thread_list.size() : pos + 1;
+        if (num_threads <= 0)
+            continue;
+
+        // Aligners are created before the timer starts
+        vector<VoskAligner *> aligners(num_threads);
+        vector<int> failed(num_threads, 0);
+        for (int t = 0; t < num_threads; t++)
+            aligners[t] = vosk_aligner_new(model, sample_rate);
+
+        double start = Now();
+        vector<thread> threads;
+        for (int t = 0; t < num_threads; t++)
+            threads.push_back(thread(Worker, aligners[t], t, num_threads, &failed[t]));
+        int total_failed = 0;
+        for (int t = 0; t < num_threads; t++) {
+            threads[t].join();
+            total_failed += failed[t];
+            vosk_aligner_free(aligners[t]);
+        }
+        double wall_sec = Now() - start;
+
+        printf("{\"bench\": \"align\", \"threads\": %d, \"utterances\": %zu, \"failed\": %d, "
+               "\"audio_sec\": %.1f, \"wall_sec\": %.2f, \"utt_per_sec\": %.1f, \"rtf\": %.4f}\n",
+               num_threads, utterances.size(), total_failed, audio_sec, wall_sec,
+               utterances.size() / wall_sec, wall_sec / audio_sec);
+        fflush(stdout);
+    }
+
+    vosk_model_free(model);
+    return 0;
+}
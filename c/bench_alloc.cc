@@ -0,0 +1,245 @@
+// Heap allocation accounting of the API calls
+//
+// The tool interposes the glibc allocator and counts allocations and
+// allocated bytes during each AcceptWaveform, PartialResult, Result and
+// GetMetadata call. The first seconds of audio are skipped so the numbers
+// describe the steady state. Statistics per call type are printed as JSON
+// lines.
+//
+// With -L the tool works as a regression check: the file lists the
+// allowed mean number of allocations per call, one "call limit" pair per
+// line, and the exit status is 1 if any limit is exceeded.
+//
+// Usage: bench_alloc [-w warmup_sec] [-p packet_ms] [-L limits] am_dir lang_dir config test.wav
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+static atomic<bool> counting(false);
+static atomic<long> num_allocs(0);
+static atomic<long> num_bytes(0);
+
+static inline void Count(size_t size)
+{
+    if (counting.load(memory_order_relaxed)) {
+        num_allocs++;
+        num_bytes += size;
+    }
+}
+
+extern "C" {
+
+void *malloc(size_t size)
+{
+    Count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    Count(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    Count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    Count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    Count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    Count(size);
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr)
+        return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+}
+
+struct CallStats {
+    long calls;
+    long allocs;
+    long bytes;
+    long max_allocs;
+};
+
+static map<string, CallStats> stats;
+
+// Counts the allocations made by the calls between Begin and End
+static void Begin()
+{
+    num_allocs = 0;
+    num_bytes = 0;
+    counting = true;
+}
+
+static void End(const char *call, bool record)
+{
+    counting = false;
+    if (!record)
+        return;
+
+    CallStats &s = stats[call];
+    s.calls++;
+    s.allocs += num_allocs;
+    s.bytes += num_bytes;
+    if (num_allocs > s.max_allocs)
+        s.max_allocs = num_allocs;
+}
+
+static bool ReadWav(const char *path, vector<short> &audio, float &sample_rate)
+{
+    unsigned char header[44];
+    FILE *wavin = fopen(path, "rb");
+
+    if (!wavin || fread(header, 1, 44, wavin) != 44) {
+        fprintf(stderr, "Can't read %s\n", path);
+        if (wavin)
+            fclose(wavin);
+        return false;
+    }
+    sample_rate = header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
+
+    short buf[4096];
+    size_t nread;
+    while ((nread = fread(buf, sizeof(short), 4096, wavin)) > 0)
+        audio.insert(audio.end(), buf, buf + nread);
+    fclose(wavin);
+    return !audio.empty();
+}
+
+int main(int argc, char **argv)
+{
+    double warmup_sec = 1.0, packet_ms = 100;
+    const char *limits_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:p:L:")) != -1) {
+        switch (opt) {
+        case 'w': warmup_sec = atof(optarg); break;
+        case 'p': packet_ms = atof(optarg); break;
+        case 'L': limits_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-w warmup_sec] [-p packet_ms] [-L limits] am_dir lang_dir config test.wav\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 4) {
+        fprintf(stderr, "Usage: %s [-w warmup_sec] [-p packet_ms] [-L limits] am_dir lang_dir config test.wav\n", argv[0]);
+        return 1;
+    }
+
+    vector<short> audio;
+    float sample_rate;
+    if (!ReadWav(argv[optind + 3], audio, sample_rate))
+        return 1;
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+    VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+
+    size_t packet = sample_rate * packet_ms / 1000;
+    size_t warmup = sample_rate * warmup_sec;
+    for (size_t i = 0; i < audio.size(); i += packet) {
+        size_t len = min(packet, audio.size() - i);
+        bool record = i >= warmup;
+
+        Begin();
+        bool endpoint = vosk_recognizer_accept_waveform(recognizer, (const char *)&audio[i], len * sizeof(short));
+        End("accept_waveform", record);
+
+        if (endpoint) {
+            Begin();
+            vosk_recognizer_result(recognizer);
+            End("result", record);
+
+            Begin();
+            vosk_recognizer_get_metadata(recognizer);
+            End("get_metadata", record);
+        } else {
+            Begin();
+            vosk_recognizer_partial_result(recognizer);
+            End("partial_result", record);
+        }
+    }
+
+    Begin();
+    vosk_recognizer_final_result(recognizer);
+    End("final_result", true);
+
+    Begin();
+    vosk_recognizer_get_metadata(recognizer);
+    End("get_metadata", true);
+
+    vosk_recognizer_free(recognizer);
+    vosk_model_free(model);
+
+    for (map<string, CallStats>::iterator it = stats.begin(); it != stats.end(); ++it) {
+        const CallStats &s = it->second;
+        printf("{\"bench\": \"alloc\", \"call\": \"%s\", \"calls\": %ld, \"allocs_per_call\": %.1f, "
+               "\"bytes_per_call\": %.0f, \"max_allocs\": %ld}\n",
+               it->first.c_str(), s.calls, (double)s.allocs / s.calls, (double)s.bytes / s.calls, s.max_allocs);
+    }
+
+    int status = 0;
+    if (limits_path) {
+        FILE *limits = fopen(limits_path, "r");
+        char call[64];
+        double limit;
+        if (!limits) {
+            fprintf(stderr, "Can't read %s\n", limits_path);
+            return 1;
+        }
+        while (fscanf(limits, "%63s %lf", call, &limit) == 2) {
+            map<string, CallStats>::iterator it = stats.find(call);
+            if (it == stats.end())
+                continue;
+            double allocs = (double)it->second.allocs / it->second.calls;
+            if (allocs > limit) {
+                fprintf(stderr, "%s: %.1f allocations per call, limit is %.1f\n", call, allocs, limit);
+                status = 1;
+            }
+        }
+        fclose(limits);
+    }
+    return status;
+}
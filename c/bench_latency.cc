@@ -0,0 +1,221 @@
+// Streaming latency benchmark
+//
+// Feeds the audio files at real-time pace in packets of fixed duration
+// through vosk_recognizer_accept_waveform and measures for every word:
+//
+//  - partial latency, delay between the end of the word in the audio and
+//    the moment it first appears in the partial result in its final form
+//  - final latency, delay between the end of the word and the result
+//    which commits it
+//
+// and for every detected endpoint the delay between the end of the last
+// word of the utterance and the moment endpoint is reported.
+//
+// Word end times are taken from the recognizer metadata. Percentiles over
+// all files are printed as a JSON line.
+//
+// Usage: bench_latency [-p packet_ms] [-s speed] am_dir lang_dir config test1.wav [test2.wav ...]
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Word {
+    string word;
+    double end;
+};
+
+static double Now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool ReadWav(const char *path, vector<short> &audio, float &sample_rate)
+{
+    unsigned char header[44];
+    FILE *wavin = fopen(path, "rb");
+
+    if (!wavin || fread(header, 1, 44, wavin) != 44) {
+        fprintf(stderr, "Can't read %s\n", path);
+        if (wavin)
+            fclose(wavin);
+        return false;
+    }
+    sample_rate = header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
+
+    short buf[4096];
+    size_t nread;
+    audio.clear();
+    while ((nread = fread(buf, sizeof(short), 4096, wavin)) > 0)
+        audio.insert(audio.end(), buf, buf + nread);
+    fclose(wavin);
+    return true;
+}
+
+// Extracts the words of {"partial": "..."} result
+static vector<string> PartialWords(const char *json)
+{
+    vector<string> words;
+    const char *start = strstr(json, "\"partial\": \"");
+
+    if (!start)
+        return words;
+    start += strlen("\"partial\": \"");
+    const char *end = strchr(start, '"');
+    if (!end)
+        return words;
+
+    istringstream ss(string(start, end - start));
+    string word;
+    while (ss >> word)
+        words.push_back(word);
+    return words;
+}
+
+// Extracts the words with end times from the metadata JSON, keys of each
+// word object are dumped in sorted order: conf, end, start, word
+static vector<Word> MetadataWords(const char *json)
+{
+    vector<Word> words;
+    const char *p = strstr(json, "\"words\"");
+
+    while (p && (p = strstr(p, "\"end\" : ")) != NULL) {
+        Word w;
+        w.end = atof(p + strlen("\"end\" : "));
+        p = strstr(p, "\"word\" : \"");
+        if (!p)
+            break;
+        p += strlen("\"word\" : \"");
+        const char *end = strchr(p, '"');
+        if (!end)
+            break;
+        w.word = string(p, end - p);
+        words.push_back(w);
+        p = end;
+    }
+    return words;
+}
+
+static void PrintPercentiles(const char *name, vector<double> &values)
+{
+    if (values.empty()) {
+        printf(", \"%s\": null", name);
+        return;
+    }
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    printf(", \"%s\": {\"count\": %zu, \"p50_ms\": %.1f, \"p90_ms\": %.1f, \"p99_ms\": %.1f, \"max_ms\": %.1f}",
+           name, n, values[n / 2] * 1000, values[n * 9 / 10] * 1000,
+           values[n * 99 / 100] * 1000, values[n - 1] * 1000);
+}
+
+int main(int argc, char **argv)
+{
+    double packet_ms = 100, speed = 1.0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:s:")) != -1) {
+        switch (opt) {
+        case 'p': packet_ms = atof(optarg); break;
+        case 's': speed = atof(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-p packet_ms] [-s speed] am_dir lang_dir config test.wav...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind < 4) {
+        fprintf(stderr, "Usage: %s [-p packet_ms] [-s speed] am_dir lang_dir config test.wav...\n", argv[0]);
+        return 1;
+    }
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+
+    vector<double> partial_latency, final_latency, endpoint_latency;
+    double audio_total = 0;
+
+    for (int f = optind + 3; f < argc; f++) {
+        vector<short> audio;
+        float sample_rate;
+        if (!ReadWav(argv[f], audio, sample_rate))
+            continue;
+        audio_total += audio.size() / sample_rate;
+
+        VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+        int packet = sample_rate * packet_ms / 1000;
+
+        // Partial words of the current utterance and the time they got their current value
+        vector<string> partial;
+        vector<double> partial_since;
+        size_t committed = 0;
+
+        double stream_start = Now();
+        for (size_t i = 0; ; i = min(i + packet, audio.size())) {
+            bool last = i >= audio.size();
+            int len = last ? 0 : min((size_t)packet, audio.size() - i);
+
+            // Pace the packets, audio position i is available at stream_start + i / rate
+            double due = stream_start + (i + len) / sample_rate / speed;
+            this_thread::sleep_for(chrono::duration<double>(due - Now()));
+
+            bool endpoint = false;
+            if (last) {
+                vosk_recognizer_final_result(recognizer);
+            } else if (vosk_recognizer_accept_waveform(recognizer, (const char *)&audio[i], len * sizeof(short))) {
+                endpoint = true;
+                vosk_recognizer_result(recognizer);
+            } else {
+                vector<string> words = PartialWords(vosk_recognizer_partial_result(recognizer));
+                double now = (Now() - stream_start) * speed;
+                partial_since.resize(words.size());
+                for (size_t k = 0; k < words.size(); k++) {
+                    if (k >= partial.size() || partial[k] != words[k])
+                        partial_since[k] = now;
+                }
+                partial = words;
+                continue;
+            }
+
+            double now = (Now() - stream_start) * speed;
+            vector<Word> words = MetadataWords(vosk_recognizer_get_metadata(recognizer));
+            for (size_t k = committed; k < words.size(); k++) {
+                size_t pos = k - committed;
+                double seen = (pos < partial.size() && partial[pos] == words[k].word) ? partial_since[pos] : now;
+                partial_latency.push_back(seen - words[k].end);
+                final_latency.push_back(now - words[k].end);
+            }
+            if (endpoint && words.size() > committed)
+                endpoint_latency.push_back(now - words.back().end);
+
+            committed = words.size();
+            partial.clear();
+            partial_since.clear();
+
+            if (last)
+                break;
+        }
+
+        vosk_recognizer_free(recognizer);
+    }
+
+    printf("{\"bench\": \"latency\", \"packet_ms\": %.0f, \"speed\": %.2f, \"audio_sec\": %.1f",
+           packet_ms, speed, audio_total);
+    PrintPercentiles("partial_latency", partial_latency);
+    PrintPercentiles("final_latency", final_latency);
+    PrintPercentiles("endpoint_latency", endpoint_latency);
+    printf("}\n");
+
+    vosk_model_free(model);
+    return 0;
+}
@@ -0,0 +1,229 @@
+// Multi-stream scaling benchmark
+//
+// Runs concurrent recognizers sharing one model. For every thread count
+// the number of streams is increased until decoding can't keep up with
+// real time: a stream fails once some packet is processed later than the
+// threshold after it became available. Streams are created upfront and
+// distributed over the threads, each stream receives the same audio at
+// real-time pace with a random phase.
+//
+// Every trial and the summary for each thread count are printed as JSON
+// lines. Per-thread efficiency is the number of streams per thread
+// relative to the single thread run, memory per stream is the growth of
+// the resident set size divided by the number of streams.
+//
+// Usage: bench_streams [-t 1,2,4] [-n max_streams] [-k step] [-p packet_ms] [-l threshold_ms] am_dir lang_dir config test.wav
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Stream {
+    VoskRecognizer *recognizer;
+    double phase;
+    double max_lag;
+};
+
+struct Trial {
+    double max_lag;
+    double cpu_sec;
+    double wall_sec;
+    double mem_per_stream;
+};
+
+static vector<short> audio;
+static float sample_rate;
+static double packet_ms = 100;
+
+static double Now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double CpuTime()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Resident set size in bytes
+static double Rss()
+{
+    long pages = 0, resident = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(statm);
+    }
+    return (double)resident * sysconf(_SC_PAGESIZE);
+}
+
+static bool ReadWav(const char *path)
+{
+    unsigned char header[44];
+    FILE *wavin = fopen(path, "rb");
+
+    if (!wavin || fread(header, 1, 44, wavin) != 44) {
+        fprintf(stderr, "Can't read %s\n", path);
+        if (wavin)
+            fclose(wavin);
+        return false;
+    }
+    sample_rate = header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
+
+    short buf[4096];
+    size_t nread;
+    while ((nread = fread(buf, sizeof(short), 4096, wavin)) > 0)
+        audio.insert(audio.end(), buf, buf + nread);
+    fclose(wavin);
+    return !audio.empty();
+}
+
+// Feeds the streams owned by one thread, streams are sorted by phase
+// so the packets are processed in the order they become available
+static void Worker(vector<Stream *> streams, double start)
+{
+    size_t packet = sample_rate * packet_ms / 1000;
+
+    for (size_t i = 0; i < audio.size(); i += packet) {
+        size_t len = min(packet, audio.size() - i);
+        for (size_t s = 0; s < streams.size(); s++) {
+            Stream *stream = streams[s];
+            double due = start + stream->phase + (i + len) / sample_rate;
+            this_thread::sleep_for(chrono::duration<double>(due - Now()));
+
+            if (vosk_recognizer_accept_waveform_s(stream->recognizer, &audio[i], len))
+                vosk_recognizer_result(stream->recognizer);
+            else
+                vosk_recognizer_partial_result(stream->recognizer);
+
+            stream->max_lag = max(stream->max_lag, Now() - due);
+        }
+    }
+    for (size_t s = 0; s < streams.size(); s++)
+        vosk_recognizer_final_result(streams[s]->recognizer);
+}
+
+static Trial RunTrial(VoskModel *model, int num_threads, int num_streams)
+{
+    Trial trial;
+    double rss_start = Rss();
+
+    // Recognizers are created before the trial starts
+    vector<Stream> streams(num_streams);
+    for (int i = 0; i < num_streams; i++) {
+        streams[i].recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+        streams[i].phase = packet_ms / 1000 * rand() / RAND_MAX;
+        streams[i].max_lag = 0;
+    }
+
+    vector<vector<Stream *> > owned(num_threads);
+    for (int i = 0; i < num_streams; i++)
+        owned[i % num_threads].push_back(&streams[i]);
+    for (int t = 0; t < num_threads; t++)
+        sort(owned[t].begin(), owned[t].end(), [](const Stream *a, const Stream *b) { return a->phase < b->phase; });
+
+    double cpu_start = CpuTime();
+    double start = Now();
+    vector<thread> threads;
+    for (int t = 0; t < num_threads; t++)
+        threads.push_back(thread(Worker, owned[t], start));
+    for (int t = 0; t < num_threads; t++)
+        threads[t].join();
+
+    trial.wall_sec = Now() - start;
+    trial.cpu_sec = CpuTime() - cpu_start;
+    trial.mem_per_stream = (Rss() - rss_start) / num_streams;
+    trial.max_lag = 0;
+    for (int i = 0; i < num_streams; i++) {
+        trial.max_lag = max(trial.max_lag, streams[i].max_lag);
+        vosk_recognizer_free(streams[i].recognizer);
+    }
+    return trial;
+}
+
+int main(int argc, char **argv)
+{
+    string thread_list = "1,2,4";
+    int max_streams = 64, step = 0;
+    double threshold_ms = 500;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:k:p:l:")) != -1) {
+        switch (opt) {
+        case 't': thread_list = optarg; break;
+        case 'n': max_streams = atoi(optarg); break;
+        case 'k': step = atoi(optarg); break;
+        case 'p': packet_ms = atof(optarg); break;
+        case 'l': threshold_ms = atof(optarg); break;
+        default:
+            fprintf(stderr, "Usage: %s [-t 1,2,4] [-n max_streams] [-k step] [-p packet_ms] [-l threshold_ms] am_dir lang_dir config test.wav\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 4) {
+        fprintf(stderr, "Usage: %s [-t 1,2,4] [-n max_streams] [-k step] [-p packet_ms] [-l threshold_ms] am_dir lang_dir config test.wav\n", argv[0]);
+        return 1;
+    }
+    if (!ReadWav(argv[optind + 3]))
+        return 1;
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+    double audio_sec = audio.size() / sample_rate;
+    double base_streams_per_thread = 0;
+
+    size_t pos = 0;
+    while (pos < thread_list.size()) {
+        int num_threads = atoi(thread_list.c_str() + pos);
+        pos = thread_list.find(',', pos);
+        pos = pos == string::npos ? thread_list.size() : pos + 1;
+        if (num_threads <= 0)
+            continue;
+
+        // Streams grow by the number of threads unless the step is given
+        int stream_step = step > 0 ? step : num_threads;
+        int best = 0;
+        double best_mem = 0, best_util = 0;
+        for (int num_streams = stream_step; num_streams <= max_streams; num_streams += stream_step) {
+            Trial trial = RunTrial(model, num_threads, num_streams);
+            bool realtime = trial.max_lag * 1000 <= threshold_ms;
+            printf("{\"bench\": \"streams_trial\", \"threads\": %d, \"streams\": %d, \"max_lag_ms\": %.1f, "
+                   "\"cpu_sec\": %.2f, \"audio_sec\": %.2f, \"mem_per_stream_mb\": %.2f, \"realtime\": %s}\n",
+                   num_threads, num_streams, trial.max_lag * 1000, trial.cpu_sec, audio_sec * num_streams,
+                   trial.mem_per_stream / 1048576, realtime ? "true" : "false");
+            fflush(stdout);
+            if (!realtime)
+                break;
+            best = num_streams;
+            best_mem = trial.mem_per_stream;
+            best_util = trial.cpu_sec / (trial.wall_sec * num_threads);
+        }
+
+        double streams_per_thread = (double)best / num_threads;
+        if (base_streams_per_thread == 0)
+            base_streams_per_thread = streams_per_thread;
+        printf("{\"bench\": \"streams\", \"threads\": %d, \"max_realtime_streams\": %d, \"streams_per_thread\": %.2f, "
+               "\"efficiency\": %.2f, \"cpu_utilization\": %.2f, \"mem_per_stream_mb\": %.2f}\n",
+               num_threads, best, streams_per_thread,
+               base_streams_per_thread > 0 ? streams_per_thread / base_streams_per_thread : 0,
+               best_util, best_mem / 1048576);
+        fflush(stdout);
+    }
+
+    vosk_model_free(model);
+    return 0;
+}
@@ -0,0 +1,312 @@
+// Microbenchmarks of the hot API calls
+//
+// Every measurement is printed as a JSON line to stdout:
+//
+// {"bench": "accept_waveform_s", "chunk": 1600, "calls": 312, "mean_us": 1520.4, "p50_us": ..., "p90_us": ..., "p99_us": ..., "max_us": ..., "rtf": 0.095}
+//
+// Usage: bench_vosk [-n reps] [-m model_reps] [-g grammar] [-r norescore_lang_dir] am_dir lang_dir config test.wav
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_STAGES 32
+
+static const int chunk_sizes[] = { 160, 800, 1600, 4000 };
+
+static const char *am_path, *lang_path, *conf_path, *norescore_path, *grammar;
+static int reps = 10, model_reps = 1;
+
+static short *audio;
+static int audio_len;
+static float sample_rate;
+
+static double now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Prints the statistics of the collected call durations, audio_sec is the
+// duration of audio processed by all the calls or 0 if not applicable
+static void report(const char *bench, const char *extra, double *times, int n, double audio_sec)
+{
+    double sum = 0;
+    int i;
+
+    if (n == 0)
+        return;
+
+    qsort(times, n, sizeof(double), compare_double);
+    for (i = 0; i < n; i++)
+        sum += times[i];
+
+    printf("{\"bench\": \"%s\"%s, \"calls\": %d, \"mean_us\": %.1f, \"p50_us\": %.1f, "
+           "\"p90_us\": %.1f, \"p99_us\": %.1f, \"max_us\": %.1f",
+           bench, extra, n, sum / n, times[n / 2], times[n * 9 / 10],
+           times[n * 99 / 100], times[n - 1]);
+    if (audio_sec > 0)
+        printf(", \"rtf\": %.4f", sum / 1e6 / audio_sec);
+    printf("}\n");
+    fflush(stdout);
+}
+
+static int read_wav(const char *path)
+{
+    FILE *wavin;
+    unsigned char header[44];
+    long size;
+
+    wavin = fopen(path, "rb");
+    if (!wavin || fread(header, 1, 44, wavin) != 44) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return 0;
+    }
+    sample_rate = header[24] | (header[25] << 8) | (header[26] << 16) | (header[27] << 24);
+
+    fseek(wavin, 0, SEEK_END);
+    size = ftell(wavin) - 44;
+    fseek(wavin, 44, SEEK_SET);
+
+    audio = (short *)malloc(size);
+    audio_len = fread(audio, 1, size, wavin) / sizeof(short);
+    fclose(wavin);
+    return audio_len > 0;
+}
+
+static void bench_model_new()
+{
+    double *times = (double *)malloc(model_reps * sizeof(double));
+    int i;
+
+    for (i = 0; i < model_reps; i++) {
+        double start = now_us();
+        VoskModel *model = vosk_model_new(am_path, lang_path, conf_path);
+        times[i] = now_us() - start;
+        vosk_model_free(model);
+    }
+    report("model_new", "", times, model_reps, 0);
+    free(times);
+}
+
+static void bench_recognizer_new(VoskModel *model)
+{
+    double *times = (double *)malloc(reps * sizeof(double));
+    int i;
+
+    for (i = 0; i < reps; i++) {
+        double start = now_us();
+        VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+        times[i] = now_us() - start;
+        vosk_recognizer_free(recognizer);
+    }
+    report("recognizer_new", "", times, reps, 0);
+
+    for (i = 0; grammar && i < reps; i++) {
+        double start = now_us();
+        VoskRecognizer *recognizer = vosk_recognizer_new_grm(model, sample_rate, grammar, true);
+        times[i] = now_us() - start;
+        vosk_recognizer_free(recognizer);
+    }
+    if (grammar)
+        report("recognizer_new_grm", "", times, reps, 0);
+    free(times);
+}
+
+// Feeds the whole file with every AcceptWaveform overload and measures
+// each call, PartialResult is measured after every chunk of 0.1 second
+static void bench_accept_waveform(VoskModel *model)
+{
+    static const char *names[] = { "accept_waveform", "accept_waveform_s", "accept_waveform_f" };
+    double *times = (double *)malloc((audio_len / chunk_sizes[0] + 1) * sizeof(double));
+    float *faudio = (float *)malloc(audio_len * sizeof(float));
+    char extra[64];
+    int c, i, kind, n;
+
+    for (i = 0; i < audio_len; i++)
+        faudio[i] = audio[i];
+
+    for (kind = 0; kind < 3; kind++) {
+        for (c = 0; c < (int)(sizeof(chunk_sizes) / sizeof(chunk_sizes[0])); c++) {
+            VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+            int chunk = chunk_sizes[c];
+
+            for (i = 0, n = 0; i < audio_len; i += chunk, n++) {
+                int len = audio_len - i < chunk ? audio_len - i : chunk;
+                double start = now_us();
+                if (kind == 0)
+                    vosk_recognizer_accept_waveform(recognizer, (const char *)(audio + i), len * sizeof(short));
+                else if (kind == 1)
+                    vosk_recognizer_accept_waveform_s(recognizer, audio + i, len);
+                else
+                    vosk_recognizer_accept_waveform_f(recognizer, faudio + i, len);
+                times[n] = now_us() - start;
+            }
+            snprintf(extra, sizeof(extra), ", \"chunk\": %d", chunk);
+            report(names[kind], extra, times, n, audio_len / sample_rate);
+            vosk_recognizer_free(recognizer);
+        }
+    }
+
+    VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, true);
+    int chunk = sample_rate / 10;
+    for (i = 0, n = 0; i < audio_len; i += chunk, n++) {
+        int len = audio_len - i < chunk ? audio_len - i : chunk;
+        vosk_recognizer_accept_waveform_s(recognizer, audio + i, len);
+        double start = now_us();
+        vosk_recognizer_partial_result(recognizer);
+        times[n] = now_us() - start;
+    }
+    report("partial_result", "", times, n, 0);
+    vosk_recognizer_free(recognizer);
+
+    free(faudio);
+    free(times);
+}
+
+// Measures Result (lattice generation, rescoring, word alignment and MBR)
+// and GetMetadata on the whole file without endpointing
+static void bench_result(VoskModel *model, const char *extra)
+{
+    double *result_times = (double *)malloc(reps * sizeof(double));
+    double *metadata_times = (double *)malloc(reps * sizeof(double));
+    int i;
+
+    for (i = 0; i < reps; i++) {
+        VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, false);
+        vosk_recognizer_accept_waveform_s(recognizer, audio, audio_len);
+
+        double start = now_us();
+        vosk_recognizer_final_result(recognizer);
+        result_times[i] = now_us() - start;
+
+        start = now_us();
+        vosk_recognizer_get_metadata(recognizer);
+        metadata_times[i] = now_us() - start;
+
+        vosk_recognizer_free(recognizer);
+    }
+    report("final_result", extra, result_times, reps, 0);
+    report("get_metadata", extra, metadata_times, reps, 0);
+
+    free(result_times);
+    free(metadata_times);
+}
+
+// Collects the spans of GetResult substeps from the trace file written
+// by vosk_trace_start, one event per line
+static void report_trace(const char *path, const char *extra)
+{
+    char names[MAX_STAGES][64];
+    double *times[MAX_STAGES];
+    int counts[MAX_STAGES];
+    int num_stages = 0, i;
+    char line[512], name[64], stage_extra[128];
+    long long ts, dur;
+    FILE *trace;
+
+    trace = fopen(path, "r");
+    if (!trace)
+        return;
+
+    while (fgets(line, sizeof(line), trace)) {
+        if (sscanf(line, "{\"name\": \"%63[^\"]\", \"cat\": \"vosk\", \"ph\": \"X\", \"ts\": %lld, \"dur\": %lld",
+                   name, &ts, &dur) != 3)
+            continue;
+        for (i = 0; i < num_stages; i++)
+            if (strcmp(names[i], name) == 0)
+                break;
+        if (i == num_stages) {
+            if (num_stages == MAX_STAGES)
+                continue;
+            strcpy(names[i], name);
+            times[i] = (double *)malloc(reps * sizeof(double));
+            counts[i] = 0;
+            num_stages++;
+        }
+        if (counts[i] % reps == 0 && counts[i] > 0)
+            times[i] = (double *)realloc(times[i], (counts[i] + reps) * sizeof(double));
+        times[i][counts[i]++] = dur;
+    }
+    fclose(trace);
+
+    for (i = 0; i < num_stages; i++) {
+        snprintf(stage_extra, sizeof(stage_extra), ", \"stage\": \"%s\"%s", names[i], extra);
+        report("result_stage", stage_extra, times[i], counts[i], 0);
+        free(times[i]);
+    }
+}
+
+static void bench_result_stages(VoskModel *model, const char *extra)
+{
+    char path[] = "/tmp/bench_vosk_trace_XXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd < 0)
+        return;
+    close(fd);
+
+    vosk_trace_start(path);
+    bench_result(model, ", \"traced\": true");
+    vosk_trace_stop();
+
+    report_trace(path, extra);
+    unlink(path);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:m:g:r:")) != -1) {
+        switch (opt) {
+        case 'n': reps = atoi(optarg); break;
+        case 'm': model_reps = atoi(optarg); break;
+        case 'g': grammar = optarg; break;
+        case 'r': norescore_path = optarg; break;
+        default:
+            fprintf(stderr, "Usage: %s [-n reps] [-m model_reps] [-g grammar] [-r norescore_lang_dir] am_dir lang_dir config test.wav\n", argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 4) {
+        fprintf(stderr, "Usage: %s [-n reps] [-m model_reps] [-g grammar] [-r norescore_lang_dir] am_dir lang_dir config test.wav\n", argv[0]);
+        return 1;
+    }
+    am_path = argv[optind];
+    lang_path = argv[optind + 1];
+    conf_path = argv[optind + 2];
+    if (!read_wav(argv[optind + 3]))
+        return 1;
+
+    vosk_set_log_level(-1);
+
+    bench_model_new();
+
+    VoskModel *model = vosk_model_new(am_path, lang_path, conf_path);
+    bench_recognizer_new(model);
+    bench_accept_waveform(model);
+    bench_result(model, ", \"lang\": \"default\"");
+    bench_result_stages(model, ", \"lang\": \"default\"");
+    vosk_model_free(model);
+
+    if (norescore_path) {
+        model = vosk_model_new(am_path, norescore_path, conf_path);
+        bench_result(model, ", \"lang\": \"norescore\"");
+        bench_result_stages(model, ", \"lang\": \"norescore\"");
+        vosk_model_free(model);
+    }
+
+    free(audio);
+    return 0;
+}
@@ -0,0 +1,212 @@
+#!/bin/bash
+
+# Builds a tiny but structurally complete model with random weights, so the
+# examples and benchmarks can run without downloading a real model.
+#
+# Usage: make_tiny_model.sh <kaldi-root> <output-dir>
+#
+# Layout of the result:
+#
+#   am/final.mdl                 random chain-style nnet3 TDNN
+#   am/conf/online.conf          decoding, feature and i-vector configuration
+#   am/conf/mfcc.conf
+#   am/ivector/                  i-vector extractor with a diagonal UBM
+#   graph/HCLG.fst               precompiled graph
+#   graph/words.txt
+#   graph/phones.txt             phone names for alignments
+#   graph/word_boundary.int
+#   graph/rescore/G.carpa        rescoring LM
+#   graph/rescore/G.fst
+#   graph-lookahead/HCLr.fst     lookahead graph for grammar recognizers
+#   graph-lookahead/Gr.fst
+#   graph-lookahead/disambig_tid.int
+#   graph-lookahead/words.txt
+#   graph-lookahead/phones.txt
+#   graph-lookahead/word_boundary.int
+#
+# Use it as vosk_model_new("<dir>/am", "<dir>/graph", "<dir>/am/conf/online.conf").
+# Recognition output is meaningless, only structure and sizes matter.
+
+set -e -x
+
+if [ $# != 2 ]; then
+    echo "Usage: $0 <kaldi-root> <output-dir>"
+    exit 1
+fi
+
+KALDI_ROOT=$(cd $1; pwd)
+mkdir -p $2
+dir=$(cd $2; pwd)
+
+feat_dim=40
+ivector_dim=10
+hidden_dim=64
+
+export PATH=$KALDI_ROOT/egs/wsj/s5/utils:$KALDI_ROOT/tools/openfst/bin:$PATH
+for bin in bin fstbin gmmbin featbin ivectorbin lmbin nnet3bin latbin; do
+    export PATH=$KALDI_ROOT/src/$bin:$PATH
+done
+export LC_ALL=C
+
+tmp=$dir/tmp
+rm -rf $tmp
+mkdir -p $tmp/dict $dir/am/conf $dir/am/ivector
+
+cd $KALDI_ROOT/egs/wsj/s5
+
+# Lexicon of digits with a small phone set
+cat > $tmp/dict/lexicon.txt <<EOF
+<unk> SPN
+one W AH N
+two T UW
+three TH R IY
+four F AO R
+five F AY V
+six S IH K S
+seven S EH V AH N
+eight EY T
+nine N AY N
+zero Z IH R OW
+yes Y EH S
+no N OW
+EOF
+echo SIL > $tmp/dict/optional_silence.txt
+printf "SIL\nSPN\n" > $tmp/dict/silence_phones.txt
+cut -d ' ' -f 2- $tmp/dict/lexicon.txt | tr ' ' '\n' | grep -v -e SPN -e '^$' | sort -u > $tmp/dict/nonsilence_phones.txt
+touch $tmp/dict/extra_questions.txt
+
+utils/prepare_lang.sh --position-dependent-phones true $tmp/dict "<unk>" $tmp/lang_tmp $tmp/lang
+
+# Bigram LM with uniform probabilities over all word pairs
+words=$(cut -d ' ' -f 1 $tmp/dict/lexicon.txt)
+{
+    num_words=$(echo $words | wc -w)
+    echo "\\data\\"
+    echo "ngram 1=$((num_words + 2))"
+    echo "ngram 2=$((num_words * num_words))"
+    echo
+    echo "\\1-grams:"
+    echo "-1.0 </s>"
+    echo "-99 <s> -0.5"
+    for w in $words; do echo "-1.2 $w -0.3"; done
+    echo
+    echo "\\2-grams:"
+    for w1 in $words; do for w2 in $words; do echo "-1.1 $w1 $w2"; done; done
+    echo
+    echo "\\end\\"
+} > $tmp/lm.arpa
+arpa2fst --disambig-symbol=#0 --read-symbol-table=$tmp/lang/words.txt $tmp/lm.arpa $tmp/lang/G.fst
+
+# Chain topology: one emitting state per phone with separate forward and self-loop pdfs
+phones=$(cat $tmp/lang/phones/silence.int $tmp/lang/phones/nonsilence.int | tr '\n' ' ')
+cat > $tmp/topo <<EOF
+<Topology>
+<TopologyEntry>
+<ForPhones>
+$phones
+</ForPhones>
+<State> 0 <ForwardPdfClass> 0 <SelfLoopPdfClass> 1 <Transition> 0 0.5 <Transition> 1 0.5 </State>
+<State> 1 </State>
+</TopologyEntry>
+</Topology>
+EOF
+cp $tmp/topo $tmp/lang/topo
+
+gmm-init-mono --shared-phones=$tmp/lang/phones/sets.int $tmp/lang/topo $feat_dim $tmp/mono.mdl $tmp/tree
+num_pdfs=$(tree-info $tmp/tree | grep num-pdfs | awk '{print $2}')
+
+# Random TDNN with i-vector input and log-softmax output
+cat > $tmp/nnet.config <<EOF
+input-node name=ivector dim=$ivector_dim
+input-node name=input dim=$feat_dim
+component name=tdnn1.affine type=NaturalGradientAffineComponent input-dim=$((feat_dim * 3 + ivector_dim)) output-dim=$hidden_dim
+component-node name=tdnn1.affine component=tdnn1.affine input=Append(Offset(input,-1),input,Offset(input,1),ReplaceIndex(ivector,t,0))
+component name=tdnn1.relu type=RectifiedLinearComponent dim=$hidden_dim
+component-node name=tdnn1.relu component=tdnn1.relu input=tdnn1.affine
+component name=tdnn2.affine type=NaturalGradientAffineComponent input-dim=$((hidden_dim * 2)) output-dim=$hidden_dim
+component-node name=tdnn2.affine component=tdnn2.affine input=Append(Offset(tdnn1.relu,-3),tdnn1.relu)
+component name=tdnn2.relu type=RectifiedLinearComponent dim=$hidden_dim
+component-node name=tdnn2.relu component=tdnn2.relu input=tdnn2.affine
+component name=output.affine type=NaturalGradientAffineComponent input-dim=$hidden_dim output-dim=$num_pdfs
+component-node name=output.affine component=output.affine input=tdnn2.relu
+component name=output.log-softmax type=LogSoftmaxComponent dim=$num_pdfs
+component-node name=output.log-softmax component=output.log-softmax input=output.affine
+output-node name=output input=output.log-softmax objective=linear
+EOF
+nnet3-init $tmp/nnet.config $tmp/final.raw
+copy-transition-model $tmp/mono.mdl $tmp/trans.mdl
+nnet3-am-init $tmp/trans.mdl $tmp/final.raw $dir/am/final.mdl
+mkdir -p $tmp/am
+cp $dir/am/final.mdl $tmp/tree $tmp/am/
+
+# Graphs
+utils/mkgraph.sh --self-loop-scale 1.0 $tmp/lang $tmp/am $tmp/graph
+mkdir -p $dir/graph/rescore
+cp $tmp/graph/HCLG.fst $tmp/graph/words.txt $tmp/lang/phones.txt $dir/graph/
+cp $tmp/lang/phones/word_boundary.int $dir/graph/
+
+utils/mkgraph_lookahead.sh --self-loop-scale 1.0 $tmp/lang $tmp/am $tmp/graph_lookahead
+mkdir -p $dir/graph-lookahead
+cp $tmp/graph_lookahead/HCLr.fst $tmp/graph_lookahead/Gr.fst $tmp/graph_lookahead/disambig_tid.int $dir/graph-lookahead/
+cp $tmp/lang/words.txt $tmp/lang/phones.txt $tmp/lang/phones/word_boundary.int $dir/graph-lookahead/
+
+# Rescoring LM
+gzip -c $tmp/lm.arpa > $tmp/lm.arpa.gz
+utils/build_const_arpa_lm.sh $tmp/lm.arpa.gz $tmp/lang $tmp/lang_rescore
+cp $tmp/lang_rescore/G.carpa $tmp/lang/G.fst $dir/graph/rescore/
+
+# I-vector extractor trained on nothing: identity LDA, unit global CMVN
+# and a diagonal UBM initialized from random features, the extractor is
+# initialized from its full-covariance copy
+awk -v dim=$feat_dim 'BEGIN { srand(1); print "rand ["; for (i = 0; i < 500; i++) { for (j = 0; j < dim; j++) printf "%f ", rand() * 2 - 1; print (i == 499 ? "]" : "") } }' > $tmp/feats.txt
+copy-feats ark,t:$tmp/feats.txt ark:$tmp/feats.ark
+gmm-global-init-from-feats --num-gauss=8 --num-iters=2 ark:$tmp/feats.ark $tmp/final.ubm
+gmm-global-copy --binary=true $tmp/final.ubm $dir/am/ivector/final.dubm
+gmm-global-to-fgmm $tmp/final.ubm $tmp/final.fubm
+ivector-extractor-init --ivector-dim=$ivector_dim --use-weights=false $tmp/final.fubm $dir/am/ivector/final.ie
+
+awk -v dim=$feat_dim 'BEGIN { print "["; for (i = 0; i < dim; i++) { for (j = 0; j < dim; j++) printf "%d ", i == j; print (i == dim - 1 ? "]" : "") } }' > $tmp/lda.txt
+copy-matrix $tmp/lda.txt $dir/am/ivector/final.mat
+awk -v dim=$feat_dim 'BEGIN { print "["; for (j = 0; j < dim; j++) printf "0 "; print "1000"; for (j = 0; j < dim; j++) printf "1000 "; print "0 ]" }' > $tmp/cmvn.txt
+copy-matrix $tmp/cmvn.txt $dir/am/ivector/global_cmvn.stats
+
+cat > $dir/am/conf/mfcc.conf <<EOF
+--use-energy=false
+--sample-frequency=16000
+--num-mel-bins=$feat_dim
+--num-ceps=$feat_dim
+--low-freq=20
+--high-freq=-400
+EOF
+echo "--left-context=0 --right-context=0" > $dir/am/ivector/splice.conf
+echo "--norm-means=false --norm-vars=false" > $dir/am/ivector/online_cmvn.conf
+cat > $dir/am/ivector/ivector_extractor.conf <<EOF
+--splice-config=$dir/am/ivector/splice.conf
+--cmvn-config=$dir/am/ivector/online_cmvn.conf
+--lda-matrix=$dir/am/ivector/final.mat
+--global-cmvn-stats=$dir/am/ivector/global_cmvn.stats
+--diag-ubm=$dir/am/ivector/final.dubm
+--ivector-extractor=$dir/am/ivector/final.ie
+--num-gselect=2
+--min-post=0.025
+--posterior-scale=0.1
+--max-remembered-frames=1000
+--max-count=100
+--ivector-period=10
+EOF
+
+silence_phones=$(cat $tmp/lang/phones/silence.csl)
+cat > $dir/am/conf/online.conf <<EOF
+--feature-type=mfcc
+--mfcc-config=$dir/am/conf/mfcc.conf
+--ivector-extraction-config=$dir/am/ivector/ivector_extractor.conf
+--frame-subsampling-factor=3
+--frames-per-chunk=51
+--acoustic-scale=1.0
+--beam=10.0
+--lattice-beam=4.0
+--max-active=1000
+--endpoint.silence-phones=$silence_phones
+EOF
+
+rm -rf $tmp
@@ -0,0 +1,216 @@
+// Fingerprint cache test
+//
+// The first part needs no model: two streams add their blocks to the
+// cache at the same time, then a third stream plays the audio of the
+// first one shifted by a fraction of a block. Every block of the third
+// stream straddles two stored blocks and must hit, with the stored words
+// shifted to the new timeline.
+//
+// The second part runs when a model is given: the clip is decoded twice
+// with the cache enabled, the second time after a short silence, and the
+// words reused from the cache must match the words of the first run
+// shifted by the silence.
+//
+// Usage: test_fingerprint_cache [am_dir lang_dir config test.wav]
+
+#include "fingerprint_cache.h"
+#include "vosk_api.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#define TEST_RATE 8000
+#define TEST_SHIFT_SAMPLES 1234
+#define TEST_SILENCE_SEC 0.37
+#define TEST_TOLERANCE_SEC 0.05
+
+// Tones changing every 100 ms with some noise, like music on hold
+static vector<BaseFloat> MakeMusic(unsigned seed, size_t len)
+{
+    std::mt19937 gen(seed);
+    std::normal_distribution<float> noise(0, 1);
+    vector<BaseFloat> music(len);
+    float f1 = 0, f2 = 0;
+    double phase1 = 0, phase2 = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (i % (TEST_RATE / 10) == 0) {
+            f1 = 300 + gen() % 2500;
+            f2 = 300 + gen() % 2500;
+        }
+        phase1 += 2 * M_PI * f1 / TEST_RATE;
+        phase2 += 2 * M_PI * f2 / TEST_RATE;
+        music[i] = 3000 * sin(phase1) + 2000 * sin(phase2) + 50 * noise(gen);
+    }
+    return music;
+}
+
+static bool TestInterleavedStreams()
+{
+    FingerprintCacheConfig config;
+    FingerprintCache cache(config);
+    size_t block = TEST_RATE;
+
+    vector<BaseFloat> music = MakeMusic(1, TEST_RATE * 20);
+    vector<BaseFloat> other = MakeMusic(2, TEST_RATE * 20);
+    Fingerprinter fp1(TEST_RATE), fp2(TEST_RATE);
+
+    // A word in the middle of every block of the first stream
+    for (size_t pos = 0; pos + block <= music.size(); pos += block) {
+        vector<uint32> fingerprint;
+        int64 first = fp1.Compute(&music[pos], block, &fingerprint);
+        cache.Add(1, TEST_RATE, fp1.FrameTime(first), fp1.HopDuration(), fingerprint);
+        double start = (double)pos / TEST_RATE + 0.5;
+        vector<FingerprintWord> words = { { "w" + std::to_string(pos / block), start, start + 0.2, 1.0 } };
+        cache.AddWords(1, words);
+
+        fingerprint.clear();
+        first = fp2.Compute(&other[pos], block, &fingerprint);
+        cache.Add(2, TEST_RATE, fp2.FrameTime(first), fp2.HopDuration(), fingerprint);
+    }
+
+    Fingerprinter fp3(TEST_RATE);
+    vector<BaseFloat> shifted(music.begin() + TEST_SHIFT_SAMPLES, music.end());
+    double shift = -(double)TEST_SHIFT_SAMPLES / TEST_RATE;
+    int hits = 0, blocks = 0;
+    for (size_t pos = 0; pos + block <= shifted.size(); pos += block, blocks++) {
+        vector<uint32> fingerprint;
+        int64 first = fp3.Compute(&shifted[pos], block, &fingerprint);
+        vector<FingerprintWord> words;
+        if (!cache.Lookup(TEST_RATE, fingerprint, fp3.FrameTime(first), &words))
+            continue;
+        hits++;
+        for (const FingerprintWord &word : words) {
+            double expected = atoi(word.word.c_str() + 1) + 0.5 + shift;
+            if (fabs(word.start - expected) > TEST_TOLERANCE_SEC) {
+                fprintf(stderr, "Word %s at %.3f, expected %.3f\n", word.word.c_str(), word.start, expected);
+                return false;
+            }
+        }
+    }
+
+    // The first block holds less than a full hop of history
+    if (hits < blocks - 1) {
+        fprintf(stderr, "Only %d of %d shifted blocks hit the cache\n", hits, blocks);
+        return false;
+    }
+    return true;
+}
+
+struct Word {
+    string word;
+    double start;
+};
+
+// Raw value of a key in JSON written by the library, strings unquoted
+static string Field(const string &json, const char *key)
+{
+    string name = string("\"") + key + "\"";
+    size_t pos = json.find(name);
+    if (pos == string::npos)
+        return "";
+    pos = json.find_first_not_of(" :", pos + name.size());
+    if (pos == string::npos)
+        return "";
+    if (json[pos] == '"')
+        return json.substr(pos + 1, json.find('"', pos + 1) - pos - 1);
+    return json.substr(pos, json.find_first_of(",}\n", pos) - pos);
+}
+
+static vector<Word> Decode(VoskModel *model, const vector<short> &audio, float sample_rate, bool cached)
+{
+    VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, false);
+    size_t chunk = sample_rate / 5;
+    for (size_t pos = 0; pos < audio.size(); pos += chunk) {
+        size_t len = audio.size() - pos < chunk ? audio.size() - pos : chunk;
+        if (vosk_recognizer_accept_waveform_s(recognizer, &audio[pos], len))
+            vosk_recognizer_result(recognizer);
+    }
+    vosk_recognizer_final_result(recognizer);
+
+    // Word objects of the metadata have no nested objects
+    vector<Word> words;
+    string metadata = vosk_recognizer_get_metadata(recognizer);
+    size_t pos = metadata.find("\"words\"");
+    size_t end = pos == string::npos ? pos : metadata.find(']', pos);
+    while (pos != string::npos && (pos = metadata.find('{', pos)) < end) {
+        string word = metadata.substr(pos, metadata.find('}', pos) - pos + 1);
+        pos += word.size();
+        if (!Field(word, "cached").empty() != cached)
+            continue;
+        Word w = { Field(word, "word"), atof(Field(word, "start").c_str()) };
+        words.push_back(w);
+    }
+    vosk_recognizer_free(recognizer);
+    return words;
+}
+
+static bool TestRepeatedClip(const char *am, const char *lang, const char *config_path, const char *wav)
+{
+    std::ifstream wavin(wav, std::ios::binary);
+    char header[44];
+    if (!wavin.read(header, sizeof(header))) {
+        fprintf(stderr, "Can't read %s\n", wav);
+        return false;
+    }
+    float sample_rate = *(int *)(header + 24);
+    vector<short> audio;
+    short sample;
+    while (wavin.read((char *)&sample, sizeof(sample)))
+        audio.push_back(sample);
+
+    // Model config with the cache enabled
+    std::ifstream config_in(config_path);
+    std::stringstream config;
+    config << config_in.rdbuf() << "\n--fingerprint-cache.enabled=true\n";
+    string cache_config = "/tmp/test_fingerprint_cache.conf";
+    std::ofstream(cache_config) << config.str();
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(am, lang, cache_config.c_str());
+
+    vector<Word> first = Decode(model, audio, sample_rate, false);
+    vector<short> repeated(sample_rate * TEST_SILENCE_SEC, 0);
+    repeated.insert(repeated.end(), audio.begin(), audio.end());
+    vector<Word> cached = Decode(model, repeated, sample_rate, true);
+
+    string stats = vosk_model_get_cache_stats(model);
+    vosk_model_free(model);
+    remove(cache_config.c_str());
+
+    if (atoi(Field(stats, "hits").c_str()) == 0) {
+        fprintf(stderr, "Repeated clip didn't hit the cache: %s\n", stats.c_str());
+        return false;
+    }
+    for (const Word &word : cached) {
+        bool found = false;
+        for (const Word &w : first)
+            found = found || (w.word == word.word && fabs(w.start + TEST_SILENCE_SEC - word.start) < TEST_TOLERANCE_SEC);
+        if (!found) {
+            fprintf(stderr, "Cached word %s at %.3f not in the first run\n", word.word.c_str(), word.start);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 1 && argc != 5) {
+        fprintf(stderr, "Usage: %s [am_dir lang_dir config test.wav]\n", argv[0]);
+        return 1;
+    }
+
+    bool ok = TestInterleavedStreams();
+    printf("interleaved streams: %s\n", ok ? "ok" : "FAILED");
+    if (argc == 5) {
+        bool repeated = TestRepeatedClip(argv[1], argv[2], argv[3], argv[4]);
+        printf("repeated clip: %s\n", repeated ? "ok" : "FAILED");
+        ok = ok && repeated;
+    }
+    return ok ? 0 : 1;
+}
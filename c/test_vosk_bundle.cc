@@ -0,0 +1,94 @@
+// Model bundle test
+//
+// Loads the same model from its directories and from a tar bundle of
+// them, decodes the WAV file with both and checks every result matches.
+// The bundle is made with "tar cf model.tar am graph" in the model
+// directory, the config of the directory model is am/conf/online.conf
+// of the same model.
+//
+// Usage: test_vosk_bundle am_dir lang_dir config model.tar test.wav
+
+#include <vosk_api.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static bool ReadFile(const char *path, string *data)
+{
+    ifstream in(path, ios::binary);
+    if (!in) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return false;
+    }
+    data->assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    return true;
+}
+
+static vector<string> Decode(VoskModel *model, const string &wav)
+{
+    float sample_rate = *(const int *)(wav.data() + 24);
+    VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, sample_rate, false);
+    vector<string> results;
+
+    size_t chunk = 3200;
+    for (size_t pos = 44; pos < wav.size(); pos += chunk) {
+        size_t len = wav.size() - pos < chunk ? wav.size() - pos : chunk;
+        if (vosk_recognizer_accept_waveform(recognizer, wav.data() + pos, len))
+            results.push_back(vosk_recognizer_result(recognizer));
+    }
+    results.push_back(vosk_recognizer_final_result(recognizer));
+
+    vosk_recognizer_free(recognizer);
+    return results;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 6) {
+        fprintf(stderr, "Usage: %s am_dir lang_dir config model.tar test.wav\n", argv[0]);
+        return 1;
+    }
+
+    string bundle, wav;
+    if (!ReadFile(argv[4], &bundle) || !ReadFile(argv[5], &wav))
+        return 1;
+    if (wav.size() < 44) {
+        fprintf(stderr, "Can't read %s\n", argv[5]);
+        return 1;
+    }
+
+    vosk_set_log_level(-1);
+    VoskModel *dir_model = vosk_model_new(argv[1], argv[2], argv[3]);
+    VoskModel *bundle_model = vosk_model_new_from_bundle(bundle.data(), bundle.size());
+    if (!dir_model || !bundle_model) {
+        fprintf(stderr, "Can't load the model from %s\n", dir_model ? argv[4] : argv[1]);
+        vosk_model_free(dir_model);
+        vosk_model_free(bundle_model);
+        return 1;
+    }
+    // The bundle only needs to stay valid while loading
+    string().swap(bundle);
+
+    vector<string> expected = Decode(dir_model, wav);
+    vector<string> results = Decode(bundle_model, wav);
+    vosk_model_free(dir_model);
+    vosk_model_free(bundle_model);
+
+    bool ok = results.size() == expected.size();
+    for (size_t i = 0; ok && i < results.size(); i++) {
+        if (results[i] != expected[i]) {
+            fprintf(stderr, "Result %zu differs:\n%s\n%s\n", i, expected[i].c_str(), results[i].c_str());
+            ok = false;
+        }
+    }
+    if (results.size() != expected.size())
+        fprintf(stderr, "%zu results from the bundle, %zu from the directories\n", results.size(), expected.size());
+
+    printf("bundle: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+// Decodes audio from standard input, for example
+//
+//   ffmpeg -loglevel quiet -i input.mp3 -ar 16000 -ac 1 -f s16le - | ./test_vosk_fd model/am model/graph model/conf/model.conf
+
+#include <vosk_api.h>
+#include <stdio.h>
+
+static void print_result(void *user_data, VoskResultType type, const char *result)
+{
+    if (type != VOSK_RESULT_PARTIAL)
+        printf("%s\n", result);
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s am_dir lang_dir config < audio\n", argv[0]);
+        return 1;
+    }
+
+    VoskModel *model = vosk_model_new(argv[1], argv[2], argv[3]);
+    VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, 16000.0, true);
+
+    int status = vosk_recognizer_accept_fd(recognizer, 0, VOSK_FORMAT_AUTO, print_result, NULL, 0);
+
+    vosk_recognizer_free(recognizer);
+    vosk_model_free(model);
+    return status != 0;
+}
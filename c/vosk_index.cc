@@ -0,0 +1,119 @@
+// Spoken term search over decoded audio
+//
+// The build command decodes audio files and writes an index of the word
+// posteriors of their lattices, the search command looks up words and
+// phrases in indices without decoding the audio again. Large archives are
+// indexed in parts, by several processes in parallel, and searched
+// together, the matches found in each index are printed as JSON.
+//
+// Usage: vosk_index build [-p min_posterior] am_dir lang_dir config index.idx file.wav...
+//        vosk_index search [-s min_score] [-n max_results] query index.idx...
+
+#include <vosk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s build [-p min_posterior] am_dir lang_dir config index.idx file.wav...\n"
+                    "       %s search [-s min_score] [-n max_results] query index.idx...\n", name, name);
+}
+
+static int Build(int argc, char **argv)
+{
+    float min_posterior = 0.05;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        switch (opt) {
+        case 'p': min_posterior = atof(optarg); break;
+        default: return -1;
+        }
+    }
+    if (argc - optind < 5)
+        return -1;
+
+    vosk_set_log_level(-1);
+    VoskModel *model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+    VoskIndexWriter *writer = vosk_index_writer_new(min_posterior);
+    const char *index_path = argv[optind + 3];
+    int failed = 0;
+
+    for (int i = optind + 4; i < argc; i++) {
+        VoskAudioFile *file = vosk_audio_file_new(argv[i], 16000);
+        if (!file) {
+            failed++;
+            continue;
+        }
+
+        VoskRecognizer *recognizer = vosk_recognizer_new(model, NULL, vosk_audio_file_sample_rate(file), false);
+        vosk_recognizer_set_index(recognizer, writer, argv[i]);
+        int endpoint;
+        while ((endpoint = vosk_recognizer_accept_audio_file(recognizer, file)) >= 0) {
+            if (endpoint)
+                vosk_recognizer_result(recognizer);
+        }
+        vosk_recognizer_final_result(recognizer);
+        vosk_recognizer_free(recognizer);
+        vosk_audio_file_free(file);
+
+        fprintf(stderr, "%d/%d %s\n", i - optind - 3, argc - optind - 4, argv[i]);
+    }
+
+    int saved = vosk_index_writer_save(writer, index_path);
+    vosk_index_writer_free(writer);
+    vosk_model_free(model);
+    if (!saved) {
+        fprintf(stderr, "Can't write %s\n", index_path);
+        return 1;
+    }
+    return failed ? 1 : 0;
+}
+
+static int Search(int argc, char **argv)
+{
+    float min_score = 0.01;
+    int max_results = 100;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:")) != -1) {
+        switch (opt) {
+        case 's': min_score = atof(optarg); break;
+        case 'n': max_results = atoi(optarg); break;
+        default: return -1;
+        }
+    }
+    if (argc - optind < 2)
+        return -1;
+
+    int failed = 0;
+    for (int i = optind + 1; i < argc; i++) {
+        VoskIndex *index = vosk_index_open(argv[i]);
+        if (!index) {
+            fprintf(stderr, "Can't open index %s\n", argv[i]);
+            failed++;
+            continue;
+        }
+        printf("%s\n", vosk_index_search(index, argv[optind], min_score, max_results));
+        vosk_index_free(index);
+    }
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+
+    if (argc > 1 && strcmp(argv[1], "build") == 0)
+        ret = Build(argc - 1, argv + 1);
+    else if (argc > 1 && strcmp(argv[1], "search") == 0)
+        ret = Search(argc - 1, argv + 1);
+
+    if (ret < 0) {
+        Usage(argv[0]);
+        return 1;
+    }
+    return ret;
+}
@@ -0,0 +1,257 @@
+// Replay of recorded recognizer traffic
+//
+// Reads files written by vosk_record_start and re-drives the recorded
+// calls against the model. Every file is replayed in its own thread so
+// the concurrency of the recorded streams is reproduced. With -s 1 the
+// calls are issued at the original pace, larger values accelerate the
+// replay and -s 0 issues them as fast as possible.
+//
+// Results and endpoint decisions which differ from the recording are
+// printed to stderr with -v. For every recording and every call type a
+// JSON line compares the recorded and replayed call durations, the exit
+// status is 1 if any result differs.
+//
+// Usage: vosk_replay [-s speed] [-S spk_model_dir] [-v] am_dir lang_dir config file.rec...
+
+#include <vosk_api.h>
+#include <recorder.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct Record {
+    uint8_t type;
+    int64_t start_us;
+    int64_t duration_us;
+    uint8_t format;
+    bool endpoint;
+    vector<char> data;
+    string result;
+};
+
+struct Recording {
+    string path;
+    float sample_rate;
+    bool online;
+    bool speaker;
+    string grammar;
+    vector<Record> records;
+};
+
+struct CallStats {
+    long calls;
+    long mismatches;
+    double recorded_us;
+    double replayed_us;
+    double recorded_max_us;
+    double replayed_max_us;
+};
+
+static const char *call_names[] = {
+    "", "accept_waveform", "partial_result", "result", "final_result", "get_metadata"
+};
+
+static VoskModel *model;
+static VoskSpkModel *spk_model;
+static double speed = 1.0;
+static bool verbose;
+
+template <typename T>
+static bool Read(FILE *f, T &value)
+{
+    return fread(&value, sizeof(value), 1, f) == 1;
+}
+
+static bool ReadRecording(const char *path, Recording &rec)
+{
+    FILE *f = fopen(path, "rb");
+    char magic[4];
+    uint32_t version, len;
+    uint8_t online, speaker;
+
+    if (!f) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return false;
+    }
+    if (fread(magic, 1, 4, f) != 4 || memcmp(magic, "VREC", 4) != 0 ||
+        !Read(f, version) || version != RECORDER_VERSION ||
+        !Read(f, rec.sample_rate) || !Read(f, online) || !Read(f, speaker) || !Read(f, len)) {
+        fprintf(stderr, "%s is not a recording of this version\n", path);
+        fclose(f);
+        return false;
+    }
+    rec.path = path;
+    rec.online = online;
+    rec.speaker = speaker;
+    rec.grammar.resize(len);
+    if (len && fread(&rec.grammar[0], 1, len, f) != len) {
+        fclose(f);
+        return false;
+    }
+
+    Record r;
+    while (Read(f, r.type) && Read(f, r.start_us) && Read(f, r.duration_us)) {
+        if (r.type == RECORD_ACCEPT) {
+            uint8_t endpoint;
+            if (!Read(f, r.format) || !Read(f, endpoint) || !Read(f, len))
+                break;
+            size_t sample_size = r.format == RECORD_FLOAT ? sizeof(float) : r.format == RECORD_SHORT ? sizeof(short) : 1;
+            r.endpoint = endpoint;
+            r.data.resize(len * sample_size);
+            if (fread(r.data.data(), 1, r.data.size(), f) != r.data.size())
+                break;
+        } else {
+            if (!Read(f, len))
+                break;
+            r.result.resize(len);
+            if (len && fread(&r.result[0], 1, len, f) != len)
+                break;
+        }
+        rec.records.push_back(r);
+    }
+    fclose(f);
+    return true;
+}
+
+static VoskRecognizer *NewRecognizer(const Recording &rec)
+{
+    if (!rec.grammar.empty())
+        return vosk_recognizer_new_grm(model, rec.sample_rate, rec.grammar.c_str(), rec.online);
+    return vosk_recognizer_new(model, rec.speaker ? spk_model : NULL, rec.sample_rate, rec.online);
+}
+
+static void Replay(const Recording &rec, VoskRecognizer *recognizer, map<int, CallStats> &stats)
+{
+    chrono::steady_clock::time_point base = chrono::steady_clock::now();
+    for (size_t i = 0; i < rec.records.size(); i++) {
+        const Record &r = rec.records[i];
+        if (speed > 0)
+            this_thread::sleep_until(base + chrono::microseconds((int64_t)(r.start_us / speed)));
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool match;
+        const char *result = NULL;
+
+        switch (r.type) {
+        case RECORD_ACCEPT: {
+            int endpoint;
+            if (r.format == RECORD_FLOAT)
+                endpoint = vosk_recognizer_accept_waveform_f(recognizer, (const float *)r.data.data(), r.data.size() / sizeof(float));
+            else if (r.format == RECORD_SHORT)
+                endpoint = vosk_recognizer_accept_waveform_s(recognizer, (const short *)r.data.data(), r.data.size() / sizeof(short));
+            else
+                endpoint = vosk_recognizer_accept_waveform(recognizer, r.data.data(), r.data.size());
+            match = (endpoint != 0) == r.endpoint;
+            break;
+        }
+        case RECORD_PARTIAL_RESULT: result = vosk_recognizer_partial_result(recognizer); break;
+        case RECORD_RESULT: result = vosk_recognizer_result(recognizer); break;
+        case RECORD_FINAL_RESULT: result = vosk_recognizer_final_result(recognizer); break;
+        case RECORD_METADATA: result = vosk_recognizer_get_metadata(recognizer); break;
+        default: continue;
+        }
+        double duration = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (result)
+            match = r.result == result;
+
+        CallStats &s = stats[r.type];
+        s.calls++;
+        s.recorded_us += r.duration_us;
+        s.replayed_us += duration;
+        if (r.duration_us > s.recorded_max_us)
+            s.recorded_max_us = r.duration_us;
+        if (duration > s.replayed_max_us)
+            s.replayed_max_us = duration;
+
+        if (!match) {
+            s.mismatches++;
+            if (verbose) {
+                if (result)
+                    fprintf(stderr, "%s: call %zu %s differs\n  recorded: %s\n  replayed: %s\n",
+                            rec.path.c_str(), i, call_names[r.type], r.result.c_str(), result);
+                else
+                    fprintf(stderr, "%s: call %zu endpoint differs, recorded %d\n", rec.path.c_str(), i, r.endpoint);
+            }
+        }
+    }
+}
+
+static void Usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-s speed] [-S spk_model_dir] [-v] am_dir lang_dir config file.rec...\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *spk_model_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:S:v")) != -1) {
+        switch (opt) {
+        case 's': speed = atof(optarg); break;
+        case 'S': spk_model_path = optarg; break;
+        case 'v': verbose = true; break;
+        default:
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind < 4) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    vector<Recording> recordings(argc - optind - 3);
+    for (size_t i = 0; i < recordings.size(); i++) {
+        if (!ReadRecording(argv[optind + 3 + i], recordings[i]))
+            return 1;
+    }
+
+    vosk_set_log_level(-1);
+    model = vosk_model_new(argv[optind], argv[optind + 1], argv[optind + 2]);
+    spk_model = spk_model_path ? vosk_spk_model_new(spk_model_path) : NULL;
+
+    // Recognizers are created and freed on the main thread, recognizer
+    // construction is not thread-safe
+    vector<VoskRecognizer *> recognizers(recordings.size());
+    for (size_t i = 0; i < recordings.size(); i++)
+        recognizers[i] = NewRecognizer(recordings[i]);
+
+    vector<map<int, CallStats> > stats(recordings.size());
+    vector<thread> threads;
+    for (size_t i = 0; i < recordings.size(); i++)
+        threads.push_back(thread(Replay, cref(recordings[i]), recognizers[i], ref(stats[i])));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    for (size_t i = 0; i < recognizers.size(); i++)
+        vosk_recognizer_free(recognizers[i]);
+
+    int status = 0;
+    for (size_t i = 0; i < recordings.size(); i++) {
+        for (map<int, CallStats>::iterator it = stats[i].begin(); it != stats[i].end(); ++it) {
+            const CallStats &s = it->second;
+            printf("{\"recording\": \"%s\", \"call\": \"%s\", \"calls\": %ld, \"mismatches\": %ld, "
+                   "\"recorded_mean_ms\": %.3f, \"replayed_mean_ms\": %.3f, "
+                   "\"recorded_max_ms\": %.3f, \"replayed_max_ms\": %.3f}\n",
+                   recordings[i].path.c_str(), call_names[it->first], s.calls, s.mismatches,
+                   s.recorded_us / s.calls / 1000, s.replayed_us / s.calls / 1000,
+                   s.recorded_max_us / 1000, s.replayed_max_us / 1000);
+            if (s.mismatches)
+                status = 1;
+        }
+    }
+
+    if (spk_model)
+        vosk_spk_model_free(spk_model);
+    vosk_model_free(model);
+    return status;
+}
@@ -0,0 +1,102 @@
+// Marshaling overhead of the AcceptWaveform overloads
+//
+// Feeds the file in 20 ms chunks through every overload with a fresh
+// recognizer and prints the mean time per call as JSON lines. Array
+// overloads need the chunk copied to its own array and marshaled, offset
+// overloads pin the whole audio array and pass a pointer. The empty call
+// rows measure the per-call cost alone with chunks of zero length.
+//
+// Usage: mono bench.exe am_dir lang_dir config test.wav
+
+using System;
+using System.Diagnostics;
+using System.IO;
+using System.Runtime.InteropServices;
+using Kaldi;
+
+public class Bench
+{
+    const int EmptyCalls = 100000;
+
+    static Model model;
+    static float sampleRate;
+    static int chunk;
+
+    static void Report(string call, long calls, double seconds)
+    {
+        Console.WriteLine("{{\"bench\": \"marshal\", \"call\": \"{0}\", \"chunk_ms\": 20, \"calls\": {1}, \"us_per_call\": {2:F2}}}",
+                          call, calls, seconds * 1e6 / calls);
+    }
+
+    static void Run(string call, int length, Action<KaldiRecognizer, int, int> accept)
+    {
+        KaldiRecognizer rec = new KaldiRecognizer(model, null, sampleRate, true);
+        Stopwatch watch = Stopwatch.StartNew();
+        long calls = 0;
+        for (int i = 0; i < length; i += chunk, calls++) {
+            accept(rec, i, Math.Min(chunk, length - i));
+        }
+        watch.Stop();
+        rec.FinalResult();
+        Report(call, calls, watch.Elapsed.TotalSeconds);
+
+        rec = new KaldiRecognizer(model, null, sampleRate, true);
+        watch = Stopwatch.StartNew();
+        for (int i = 0; i < EmptyCalls; i++) {
+            accept(rec, 0, 0);
+        }
+        watch.Stop();
+        Report(call + "_empty", EmptyCalls, watch.Elapsed.TotalSeconds);
+    }
+
+    public static void Main(string[] args)
+    {
+        if (args.Length != 4) {
+            Console.Error.WriteLine("Usage: mono bench.exe am_dir lang_dir config test.wav");
+            Environment.Exit(1);
+        }
+
+        byte[] wav = File.ReadAllBytes(args[3]);
+        sampleRate = BitConverter.ToInt32(wav, 24);
+        chunk = (int)(sampleRate / 50);
+
+        byte[] bytes = new byte[wav.Length - 44];
+        Array.Copy(wav, 44, bytes, 0, bytes.Length);
+        short[] shorts = new short[bytes.Length / 2];
+        Buffer.BlockCopy(bytes, 0, shorts, 0, shorts.Length * 2);
+        float[] floats = new float[shorts.Length];
+        for (int i = 0; i < shorts.Length; i++) {
+            floats[i] = shorts[i];
+        }
+
+        Vosk.SetLogLevel(-1);
+        model = new Model(args[0], args[1], args[2]);
+
+        byte[] bchunk = new byte[chunk * 2];
+        short[] schunk = new short[chunk];
+        float[] fchunk = new float[chunk];
+
+        Run("byte_array", shorts.Length, (rec, i, len) => {
+            Array.Copy(bytes, i * 2, bchunk, 0, len * 2);
+            rec.AcceptWaveform(bchunk, len * 2);
+        });
+        Run("byte_pinned", shorts.Length, (rec, i, len) => rec.AcceptWaveform(bytes, i * 2, len * 2));
+
+        Run("short_array", shorts.Length, (rec, i, len) => {
+            Array.Copy(shorts, i, schunk, 0, len);
+            rec.AcceptWaveform(schunk, len);
+        });
+        Run("short_pinned", shorts.Length, (rec, i, len) => rec.AcceptWaveform(shorts, i, len));
+
+        Run("float_array", shorts.Length, (rec, i, len) => {
+            Array.Copy(floats, i, fchunk, 0, len);
+            rec.AcceptWaveform(fchunk, len);
+        });
+        Run("float_pinned", shorts.Length, (rec, i, len) => rec.AcceptWaveform(floats, i, len));
+
+        GCHandle handle = GCHandle.Alloc(shorts, GCHandleType.Pinned);
+        IntPtr ptr = handle.AddrOfPinnedObject();
+        Run("short_intptr", shorts.Length, (rec, i, len) => rec.AcceptWaveformShortPtr(IntPtr.Add(ptr, i * 2), len));
+        handle.Free();
+    }
+}
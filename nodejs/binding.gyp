@@ -1,4 +1,11 @@
 {
+  # Subsystems to compile out for lean builds, for example
+  # node-gyp rebuild --kaldi_root=... --vosk_disable_rescore=1
+  'variables': {
+    'vosk_disable_rescore%': 0,
+    'vosk_disable_speaker%': 0,
+    'vosk_disable_lookahead%': 0,
+  },
   'targets': [
     {
       'target_name': 'vosk',
@@ -7,6 +14,15 @@
          '../src/model.cc',
          '../src/spk_model.cc',
          '../src/vosk_api.cc',
+         '../src/trace.cc',
+         '../src/metrics.cc',
+         '../src/recorder.cc',
+         '../src/recognizer_worker.cc',
+         '../src/audio_file.cc',
+         '../src/fd_reader.cc',
+         '../src/fingerprint_cache.cc',
+         '../src/aligner.cc',
+         '../src/search_index.cc',
          'vosk_wrap.cc',
       ],
       'cflags': [
@@ -23,6 +39,15 @@
           '-fno-exceptions',
       ],
       'conditions': [
+          ['vosk_disable_rescore == 1', {
+              'defines': [ 'VOSK_DISABLE_RESCORE' ]
+          }],
+          ['vosk_disable_speaker == 1', {
+              'defines': [ 'VOSK_DISABLE_SPEAKER' ]
+          }],
+          ['vosk_disable_lookahead == 1', {
+              'defines': [ 'VOSK_DISABLE_LOOKAHEAD' ]
+          }],
           ['OS == "mac"', {
               'xcode_settings': {
                   'GCC_ENABLE_CPP_EXCEPTIONS': 'YES',
@@ -0,0 +1,37 @@
+#!/usr/bin/env node
+
+const fs = require("fs");
+const { Readable } = require("stream");
+const wav = require("wav");
+
+const { Model, KaldiRecognizer } = require("..");
+
+if (process.argv.length != 6) {
+    console.error("Usage: test-async.js am_dir lang_dir config test.wav");
+    process.exit(1);
+}
+const [amPath, langPath, confPath, wavPath] = process.argv.slice(2);
+
+const wfStream = fs.createReadStream(wavPath, {'highWaterMark': 4096});
+const wfReader = new wav.Reader();
+
+const model = new Model(amPath, langPath, confPath);
+
+wfReader.on('format', async ({ audioFormat, sampleRate, channels }) => {
+    if (audioFormat != 1 || channels != 1) {
+        console.error("Audio file must be WAV format mono PCM.");
+        process.exit(1);
+    }
+    const rec = new KaldiRecognizer(model, null, sampleRate, true);
+    for await (const data of new Readable().wrap(wfReader)) {
+        const endpoint = await rec.acceptWaveformAsync(data);
+        if (endpoint) {
+           console.log(await rec.resultAsync());
+        } else {
+           console.log(await rec.PartialResult());
+        }
+    }
+    console.log(await rec.finalResultAsync());
+});
+
+wfStream.pipe(wfReader);
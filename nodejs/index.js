@@ -1,3 +1,31 @@
 const voskNativeModule = require('./build/Release/vosk.node');
 
+// Promise versions of the asynchronous calls. Decoding runs on the libuv
+// thread pool, calls of the same recognizer are chained so only one of
+// them is in flight at a time.
+const pending = new WeakMap();
+
+function enqueue(recognizer, start) {
+    const run = () => new Promise((resolve, reject) => {
+        start((err, result) => err ? reject(err) : resolve(result));
+    });
+    const promise = (pending.get(recognizer) || Promise.resolve()).then(run, run);
+    pending.set(recognizer, promise.catch(() => {}));
+    return promise;
+}
+
+const KaldiRecognizer = voskNativeModule.KaldiRecognizer;
+
+KaldiRecognizer.prototype.acceptWaveformAsync = function (buffer) {
+    return enqueue(this, (callback) => this.AcceptWaveformAsync(buffer, callback));
+};
+
+KaldiRecognizer.prototype.resultAsync = function () {
+    return enqueue(this, (callback) => this.ResultAsync(callback));
+};
+
+KaldiRecognizer.prototype.finalResultAsync = function () {
+    return enqueue(this, (callback) => this.FinalResultAsync(callback));
+};
+
 module.exports = voskNativeModule;
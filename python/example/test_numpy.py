@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+
+# Feeds int16 and float32 numpy arrays to the recognizer without converting them to bytes
+
+from vosk import Model, KaldiRecognizer, SetLogLevel
+import sys
+import wave
+import numpy as np
+
+SetLogLevel(0)
+
+if len(sys.argv) != 5:
+    print ("Usage: test_numpy.py am_dir lang_dir config test.wav")
+    exit (1)
+
+wf = wave.open(sys.argv[4], "rb")
+if wf.getnchannels() != 1 or wf.getsampwidth() != 2 or wf.getcomptype() != "NONE":
+    print ("Audio file must be WAV format mono PCM.")
+    exit (1)
+
+model = Model(sys.argv[1], sys.argv[2], sys.argv[3])
+rec = KaldiRecognizer(model, None, wf.getframerate(), True)
+
+samples = np.frombuffer(wf.readframes(wf.getnframes()), dtype=np.int16)
+half = len(samples) // 2
+
+# int16 samples are read in place
+for chunk in np.array_split(samples[:half], max(1, half // 4000)):
+    if rec.AcceptWaveform(chunk):
+        print(rec.Result())
+
+# float32 samples are expected in 16-bit range
+for chunk in np.array_split(samples[half:].astype(np.float32), max(1, half // 4000)):
+    if rec.AcceptWaveform(chunk):
+        print(rec.Result())
+
+print(rec.FinalResult())
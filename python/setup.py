@@ -13,6 +13,8 @@ class build_py(_build_py):
 
 kaldi_root = os.getenv('KALDI_ROOT')
 kaldi_mkl = os.getenv('KALDI_MKL')
+# Subsystems to compile out for lean builds, VOSK_DISABLE="RESCORE SPEAKER LOOKAHEAD"
+vosk_disable = os.getenv('VOSK_DISABLE', '').upper().split()
 source_path = os.getenv("VOSK_SOURCE", os.path.abspath(os.path.join(os.path.abspath(os.path.dirname(__file__)), "../src")))
 
 if kaldi_root == None:
@@ -45,8 +47,9 @@ kaldi_static_libs = ['src/online2/kaldi-online2.a',
              'src/fstext/kaldi-fstext.a',
              'src/util/kaldi-util.a',
              'src/base/kaldi-base.a',
-             'tools/openfst/lib/libfst.a',
-             'tools/openfst/lib/libfstngram.a']
+             'tools/openfst/lib/libfst.a']
+if 'LOOKAHEAD' not in vosk_disable:
+    kaldi_static_libs.append('tools/openfst/lib/libfstngram.a')
 kaldi_link_args = ['-s']
 kaldi_libraries = []
 
@@ -59,10 +62,10 @@ else:
     kaldi_static_libs.append('tools/OpenBLAS/libopenblas.a')
     kaldi_libraries.append('gfortran')
 
-sources = ['kaldi_recognizer.cc', 'model.cc', 'spk_model.cc', 'vosk_api.cc', 'vosk.i']
+sources = ['kaldi_recognizer.cc', 'model.cc', 'spk_model.cc', 'vosk_api.cc', 'trace.cc', 'metrics.cc', 'recorder.cc', 'recognizer_worker.cc', 'audio_file.cc', 'fd_reader.cc', 'fingerprint_cache.cc', 'aligner.cc', 'search_index.cc', 'vosk.i']
 
 vosk_ext = Extension('vosk._vosk',
-                    define_macros = [('FST_NO_DYNAMIC_LINKING', '1')],
+                    define_macros = [('FST_NO_DYNAMIC_LINKING', '1')] + [('VOSK_DISABLE_' + x, '1') for x in vosk_disable],
                     include_dirs = [kaldi_root + '/src', kaldi_root + '/tools/openfst/include', 'vosk'],
                     swig_opts=['-outdir', 'vosk', '-c++'],
                     libraries = kaldi_libraries,
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+# Accuracy and speed regression check
+#
+# Decodes a corpus given by Kaldi-style wav.scp and text files and reports
+# WER, real-time factor and percentiles of the result latency together.
+# The report can be stored as a baseline, later runs are compared with it
+# and fail if WER or speed degrade more than allowed.
+#
+# Usage: regression.py [--baseline base.json] [--save-baseline base.json] am_dir lang_dir config wav.scp text
+
+import argparse
+import json
+import sys
+import time
+import wave
+
+from multiprocessing.dummy import Pool
+from vosk import Model, KaldiRecognizer, SetLogLevel
+
+def edit_distance(ref, hyp):
+    d = list(range(len(hyp) + 1))
+    for i in range(1, len(ref) + 1):
+        prev, d[0] = d[0], i
+        for j in range(1, len(hyp) + 1):
+            cur = min(d[j] + 1, d[j - 1] + 1, prev + (ref[i - 1] != hyp[j - 1]))
+            prev, d[j] = d[j], cur
+    return d[len(hyp)]
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+def decode(model, path, chunk):
+    wf = wave.open(path, "rb")
+    if wf.getnchannels() != 1 or wf.getsampwidth() != 2 or wf.getcomptype() != "NONE":
+        raise ValueError("%s must be WAV format mono PCM" % path)
+
+    rec = KaldiRecognizer(model, None, wf.getframerate(), True)
+    words = []
+    latencies = []
+    start = time.perf_counter()
+    while True:
+        data = wf.readframes(chunk)
+        if len(data) == 0:
+            break
+        if rec.AcceptWaveform(data):
+            t = time.perf_counter()
+            words += json.loads(rec.Result())['text'].split()
+            latencies.append(time.perf_counter() - t)
+    t = time.perf_counter()
+    words += json.loads(rec.FinalResult())['text'].split()
+    latencies.append(time.perf_counter() - t)
+
+    return words, time.perf_counter() - start, wf.getnframes() / wf.getframerate(), latencies
+
+def main():
+    parser = argparse.ArgumentParser(description="Accuracy and speed regression check")
+    parser.add_argument("am")
+    parser.add_argument("lang")
+    parser.add_argument("config")
+    parser.add_argument("wav_scp")
+    parser.add_argument("text")
+    parser.add_argument("--baseline", help="report to compare with")
+    parser.add_argument("--save-baseline", help="file to store the report")
+    parser.add_argument("--threads", type=int, default=1)
+    parser.add_argument("--chunk", type=int, default=4000, help="frames per AcceptWaveform call")
+    parser.add_argument("--max-wer-increase", type=float, default=0.1, help="absolute WER increase allowed, percent")
+    parser.add_argument("--max-rtf-increase", type=float, default=10, help="relative RTF increase allowed, percent")
+    args = parser.parse_args()
+
+    SetLogLevel(-1)
+    model = Model(args.am, args.lang, args.config)
+
+    refs = {}
+    for line in open(args.text, encoding="utf-8"):
+        parts = line.split()
+        if parts:
+            refs[parts[0]] = parts[1:]
+    utts = [line.split() for line in open(args.wav_scp) if line.strip()]
+
+    def run(utt):
+        words, decode_time, audio_time, latencies = decode(model, utt[1], args.chunk)
+        return utt[0], words, decode_time, audio_time, latencies
+
+    with Pool(args.threads) as pool:
+        results = pool.map(run, utts)
+
+    errors = ref_words = 0
+    decode_total = audio_total = 0.0
+    latencies = []
+    for uid, words, decode_time, audio_time, utt_latencies in results:
+        ref = refs.get(uid, [])
+        errors += edit_distance(ref, words)
+        ref_words += len(ref)
+        decode_total += decode_time
+        audio_total += audio_time
+        latencies += utt_latencies
+
+    report = {
+        "utterances": len(results),
+        "audio_sec": round(audio_total, 2),
+        "wer": round(100.0 * errors / max(ref_words, 1), 2),
+        "rtf": round(decode_total / max(audio_total, 1e-9), 4),
+        "latency_p50_ms": round(percentile(latencies, 50) * 1000, 1),
+        "latency_p90_ms": round(percentile(latencies, 90) * 1000, 1),
+        "latency_p99_ms": round(percentile(latencies, 99) * 1000, 1),
+    }
+
+    status = 0
+    if args.baseline:
+        base = json.load(open(args.baseline))
+        report["baseline"] = base
+        if report["wer"] > base["wer"] + args.max_wer_increase:
+            print("WER regression: %.2f -> %.2f" % (base["wer"], report["wer"]), file=sys.stderr)
+            status = 1
+        if report["rtf"] > base["rtf"] * (1 + args.max_rtf_increase / 100):
+            print("RTF regression: %.4f -> %.4f" % (base["rtf"], report["rtf"]), file=sys.stderr)
+            status = 1
+
+    print(json.dumps(report))
+    if args.save_baseline:
+        report.pop("baseline", None)
+        with open(args.save_baseline, "w") as f:
+            json.dump(report, f, indent=2)
+    sys.exit(status)
+
+main()
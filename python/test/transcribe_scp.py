@@ -14,18 +14,15 @@ def recognize(line):
     uid, fn = line.split()
     wf = wave.open(fn, "rb")
     rec = KaldiRecognizer(model, wf.getframerate())
+    wf.close()
 
-    text = ""
-    while True:
-        data = wf.readframes(1000)
-        if len(data) == 0:
-            break
-        if rec.AcceptWaveform(data):
-            jres = json.loads(rec.Result())
-            text = text + " " + jres['text']
-    jres = json.loads(rec.FinalResult())
-    text = text + " " + jres['text']
-    return (uid + text)
+    # Decodes the whole file natively without holding the GIL
+    result = rec.TranscribeFile(fn)
+    if result is None:
+        print("Can't transcribe %s" % fn, file=sys.stderr)
+        return uid
+    jres = json.loads(result)
+    return (uid + " " + jres.get('text', ''))
 
 def main():
     p = Pool(8)
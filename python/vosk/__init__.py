@@ -1,2 +1 @@
-from .vosk import KaldiRecognizer, Model, SpkModel, SetLogLevel
-
+from .vosk import KaldiRecognizer, Model, SpkModel, SetLogLevel, TraceStart, TraceStop, RecordStart, RecordStop, MetricsPrometheus
@@ -0,0 +1,125 @@
+"""asyncio interface to the recognizer
+
+Audio is decoded by a native thread per recognizer. Feeding only queues the
+data and results are delivered through the event loop when the thread
+signals them on a descriptor, so one event loop thread can drive many
+streams::
+
+    rec = AsyncRecognizer(KaldiRecognizer(model, None, 16000, True))
+    await rec.feed(chunk)
+    ...
+    await rec.finish()
+    async for result in rec:
+        print(result)
+
+Feeding waits while more than max_pending bytes of audio are queued, so a
+fast source can't run ahead of decoding without bound.
+
+The loop must support add_reader, which excludes the proactor loop on Windows.
+"""
+
+import asyncio
+import os
+import threading
+
+from .vosk import RecognizerWorker
+
+class AsyncRecognizer:
+
+    def __init__(self, recognizer, partial_results=False, loop=None, max_pending=1 << 20):
+        self._recognizer = recognizer
+        self._worker = RecognizerWorker(recognizer, partial_results)
+        self._loop = loop or asyncio.get_event_loop()
+        self._results = asyncio.Queue()
+        self._fd = self._worker.Fd()
+        self._finished = False
+        self._done = False
+        self._max_pending = max_pending
+        self._drained = None
+        self._loop.add_reader(self._fd, self._on_results)
+
+    def _on_results(self):
+        try:
+            while os.read(self._fd, 4096):
+                pass
+        except BlockingIOError:
+            pass
+
+        # Results queued before the done flag was set are complete
+        done = self._worker.Done()
+        while True:
+            result = self._worker.PopResult()
+            if result is None:
+                break
+            self._results.put_nowait(result)
+        if done:
+            self._done = True
+            self._loop.remove_reader(self._fd)
+            self._results.put_nowait(None)
+        self._wake_feeder()
+
+    def _wake_feeder(self):
+        if self._drained is None or self._drained.done():
+            return
+        if self._done or self._worker is None or self._worker.Pending() < self._max_pending:
+            self._drained.set_result(None)
+
+    async def feed(self, data):
+        """Queues 16-bit PCM audio for decoding, waits while the queue is full"""
+        while not self._done and self._worker is not None and self._worker.Pending() >= self._max_pending:
+            # Woken up by the descriptor when the thread takes audio
+            self._drained = self._loop.create_future()
+            await self._drained
+        if self._worker is not None:
+            self._worker.Feed(data)
+
+    async def finish(self):
+        """Marks the end of audio, the final result is delivered last"""
+        self._worker.Finish()
+
+    async def result(self):
+        """Returns the next result in JSON format, None after the final result"""
+        if self._finished:
+            return None
+        result = await self._results.get()
+        if result is None:
+            self._finished = True
+        return result
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        result = await self.result()
+        if result is None:
+            raise StopAsyncIteration
+        return result
+
+    def close(self):
+        """Stops decoding, pending audio is dropped
+
+        Releasing the worker joins its thread, which finishes the chunk it
+        decodes, so it is done on a separate thread to keep the event loop
+        responsive.
+        """
+        if self._worker is None:
+            return
+        if not self._done:
+            self._loop.remove_reader(self._fd)
+        objects = [self._worker, self._recognizer]
+        self._worker = None
+        self._wake_feeder()
+        try:
+            threading.Thread(target=_release, args=(objects,)).start()
+        except RuntimeError:
+            # No new threads during interpreter shutdown
+            _release(objects)
+
+    def __del__(self):
+        self.close()
+
+
+def _release(objects):
+    # The worker must be released before the recognizer
+    while objects:
+        objects.pop(0)
@@ -0,0 +1,243 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "aligner.h"
+
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice.h"
+#include "online2/online-nnet3-decoding.h"
+#include "util/text-utils.h"
+
+#include <string.h>
+
+#include "json.h"
+#include "trace.h"
+
+using namespace fst;
+
+Aligner::Aligner(Model *model, float sample_frequency) : model_(model), sample_frequency_(sample_frequency), g_fst_(NULL), decode_fst_(NULL)
+{
+    if (!kVoskLookahead)
+        KALDI_ERR << "Built without lookahead composition, alignment is not supported";
+    if (!model_->hcl_fst_)
+        KALDI_ERR << "Alignment requires a model with the HCLr.fst lexicon graph";
+    if (!model_->winfo_)
+        KALDI_ERR << "Alignment requires word boundary information in word_boundary.int";
+
+    model_->Ref();
+    stream_id_ = Tracer::Get().NewStreamId();
+
+    unk_id_ = model_->word_syms_->Find("[unk]");
+    if (unk_id_ == kNoSymbol)
+        unk_id_ = model_->word_syms_->Find("<unk>");
+
+    decoder_config_ = model_->nnet3_decoding_config_;
+    decoder_config_.lattice_beam = model_->aligner_config_.lattice_beam;
+    decoder_config_.max_active = model_->aligner_config_.max_active;
+
+    frame_shift_ = model_->feature_info_->FrameShiftInSeconds() *
+                   model_->decodable_opts_.frame_subsampling_factor;
+
+    g_fst_ = new StdVectorFst();
+}
+
+Aligner::~Aligner()
+{
+    delete decode_fst_;
+    delete g_fst_;
+    model_->Unref();
+}
+
+// Words missing in the vocabulary are aligned as the unknown word if the
+// model has one
+bool Aligner::BuildGraph(const char *text)
+{
+    SplitStringToVector(text, " \t\r\n", true, &tokens_);
+
+    next_words_.clear();
+    for (size_t i = 0; i < tokens_.size(); i++) {
+        int32 id = model_->word_syms_->Find(tokens_[i]);
+        if (id == kNoSymbol)
+            id = unk_id_;
+        if (id == kNoSymbol) {
+            KALDI_WARN << "Can't align word missing in vocabulary: '" << tokens_[i] << "'";
+            return false;
+        }
+        next_words_.push_back(id);
+    }
+
+    if (decode_fst_ && next_words_ == words_)
+        return true;
+    words_.swap(next_words_);
+
+    // The composed graph shares the grammar, it is released first so the
+    // grammar states are modified in place instead of copied
+    delete decode_fst_;
+    decode_fst_ = NULL;
+
+    g_fst_->DeleteStates();
+    g_fst_->ReserveStates(words_.size() + 1);
+    StdArc::StateId state = g_fst_->AddState();
+    g_fst_->SetStart(state);
+    for (size_t i = 0; i < words_.size(); i++) {
+        StdArc::StateId next = g_fst_->AddState();
+        g_fst_->AddArc(state, StdArc(words_[i], words_[i], TropicalWeight::One(), next));
+        state = next;
+    }
+    g_fst_->SetFinal(state, TropicalWeight::One());
+    ArcSort(g_fst_, ILabelCompare<StdArc>());
+
+#ifndef VOSK_DISABLE_LOOKAHEAD
+    decode_fst_ = LookaheadComposeFst(*model_->hcl_fst_, *g_fst_, model_->disambig_);
+#endif
+    return true;
+}
+
+// Decodes the whole utterance, fails unless a final state of the graph is
+// reached, which means the beam lost the transcript
+bool Aligner::Decode(BaseFloat beam, CompactLattice *clat)
+{
+    TraceSpan span("AlignDecode", stream_id_);
+
+    LatticeFasterDecoderConfig config = decoder_config_;
+    config.beam = beam;
+
+    OnlineNnet2FeaturePipeline feature_pipeline(*model_->feature_info_);
+    feature_pipeline.SetAdaptationState(*model_->adaptation_state_);
+    feature_pipeline.SetCmvnState(*model_->cmvn_state_);
+
+    SingleUtteranceNnet3Decoder decoder(config, *model_->trans_model_,
+            *model_->decodable_info_, *decode_fst_, &feature_pipeline);
+
+    feature_pipeline.AcceptWaveform(sample_frequency_, wave_);
+    feature_pipeline.InputFinished();
+    decoder.AdvanceDecoding();
+    decoder.FinalizeDecoding();
+
+    if (decoder.NumFramesDecoded() == 0 || !decoder.Decoder().ReachedFinal())
+        return false;
+
+    decoder.GetLattice(true, clat);
+    return true;
+}
+
+// Phones are named without the word position suffix
+string Aligner::PhoneName(int32 phone)
+{
+    if (!model_->phone_syms_)
+        return std::to_string(phone);
+
+    string name = model_->phone_syms_->Find(phone);
+    size_t len = name.size();
+    if (len > 2 && name[len - 2] == '_' && strchr("BIES", name[len - 1]))
+        name.resize(len - 2);
+    return name;
+}
+
+const char *Aligner::Align(const char *text, const char *data, int len)
+{
+    wave_.Resize(len / 2, kUndefined);
+    for (int i = 0; i < len / 2; i++)
+        wave_(i) = *(((short *)data) + i);
+    return AlignWave(text);
+}
+
+const char *Aligner::Align(const char *text, const short *sdata, int len)
+{
+    wave_.Resize(len, kUndefined);
+    for (int i = 0; i < len; i++)
+        wave_(i) = sdata[i];
+    return AlignWave(text);
+}
+
+const char *Aligner::Align(const char *text, const float *fdata, int len)
+{
+    wave_.Resize(len, kUndefined);
+    for (int i = 0; i < len; i++)
+        wave_(i) = fdata[i];
+    return AlignWave(text);
+}
+
+const char *Aligner::AlignWave(const char *text)
+{
+    TraceSpan span("Align", stream_id_);
+
+    if (!BuildGraph(text))
+        return NULL;
+
+    const AlignerConfig &config = model_->aligner_config_;
+    CompactLattice clat;
+    bool aligned = Decode(config.beam, &clat);
+    if (!aligned && config.retry_beam > config.beam) {
+        KALDI_VLOG(1) << "Retrying alignment with beam " << config.retry_beam;
+        aligned = Decode(config.retry_beam, &clat);
+    }
+    if (!aligned) {
+        KALDI_WARN << "Failed to align audio to '" << text << "'";
+        return NULL;
+    }
+
+    TraceSpan align_span("WordAlign", stream_id_);
+
+    CompactLattice best_path, aligned_lat;
+    CompactLatticeShortestPath(clat, &best_path);
+    WordAlignLattice(best_path, *model_->trans_model_, *model_->winfo_, 0, &aligned_lat);
+
+    vector<int32> words, begin_times, lengths;
+    vector<vector<int32> > prons, phone_lengths;
+    if (aligned_lat.Start() == kNoStateId ||
+        !CompactLatticeToWordProns(*model_->trans_model_, aligned_lat, &words,
+                                   &begin_times, &lengths, &prons, &phone_lengths)) {
+        KALDI_WARN << "Failed to find word boundaries of '" << text << "'";
+        return NULL;
+    }
+
+    json::JSON result;
+    stringstream result_text;
+    result["words"] = json::JSON::Make(json::JSON::Class::Array);
+
+    // Silence between words comes as words with the epsilon label, the
+    // remaining words follow the transcript
+    size_t token = 0;
+    for (size_t i = 0; i < words.size(); i++) {
+        if (words[i] == 0)
+            continue;
+
+        json::JSON word;
+        string w = token < tokens_.size() ? tokens_[token++] : model_->word_syms_->Find(words[i]);
+        word["word"] = w;
+        word["start"] = begin_times[i] * frame_shift_;
+        word["end"] = (begin_times[i] + lengths[i]) * frame_shift_;
+
+        word["phones"] = json::JSON::Make(json::JSON::Class::Array);
+        int32 t = begin_times[i];
+        for (size_t j = 0; j < prons[i].size(); j++) {
+            json::JSON phone;
+            phone["phone"] = PhoneName(prons[i][j]);
+            phone["start"] = t * frame_shift_;
+            phone["end"] = (t + phone_lengths[i][j]) * frame_shift_;
+            word["phones"].append(phone);
+            t += phone_lengths[i][j];
+        }
+        result["words"].append(word);
+
+        if (result_text.tellp() > 0)
+            result_text << " ";
+        result_text << w;
+    }
+    result["text"] = result_text.str();
+
+    result_ = result.dump();
+    return result_.c_str();
+}
@@ -0,0 +1,74 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ALIGNER_H_
+#define ALIGNER_H_
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+
+#include "model.h"
+
+#include <string>
+#include <vector>
+
+using namespace kaldi;
+using namespace std;
+
+// Forced alignment of audio to a known transcript
+//
+// The transcript is compiled into a linear grammar, one arc per word, and
+// composed on the fly with the lexicon graph of the model, so only the
+// states of the transcript words are ever expanded. The grammar buffer and
+// the composed graph are kept between utterances, the graph is rebuilt
+// only when the transcript changes and repeated prompts reuse its cached
+// states. Each aligner is used by a single thread, batches run one aligner
+// per thread over a shared model.
+class Aligner {
+
+public:
+    Aligner(Model *model, float sample_frequency);
+    ~Aligner();
+
+    // Returns word and phone timings in JSON format or NULL if the audio
+    // can't be aligned to the text
+    const char *Align(const char *text, const char *data, int len);
+    const char *Align(const char *text, const short *sdata, int len);
+    const char *Align(const char *text, const float *fdata, int len);
+
+private:
+    bool BuildGraph(const char *text);
+    bool Decode(BaseFloat beam, CompactLattice *clat);
+    const char *AlignWave(const char *text);
+    string PhoneName(int32 phone);
+
+    Model *model_;
+    float sample_frequency_;
+    int stream_id_;
+    int32 unk_id_;
+    LatticeFasterDecoderConfig decoder_config_;
+    BaseFloat frame_shift_;
+
+    fst::StdVectorFst *g_fst_;
+    fst::Fst<fst::StdArc> *decode_fst_;
+    vector<int32> words_;
+    vector<int32> next_words_;
+    vector<string> tokens_;
+    Vector<BaseFloat> wave_;
+
+    string result_;
+};
+
+#endif /* ALIGNER_H_ */
@@ -0,0 +1,188 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "audio_file.h"
+
+#include "base/kaldi-common.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Chunk duration fed per call, short enough to keep the endpoint
+// detection precise and long enough to amortize the call overhead
+#define AUDIO_FILE_CHUNK_SEC 0.2
+
+// Sample rates accepted from the caller or the WAV header, a rate below
+// the minimum would make empty chunks
+#define AUDIO_FILE_MIN_RATE 1000
+#define AUDIO_FILE_MAX_RATE 768000
+
+AudioFile::AudioFile() :
+    map_(NULL), map_size_(0), data_(NULL), num_frames_(0), pos_(0),
+    sample_rate_(0), channels_(1), sample_width_(2), float_samples_(false)
+{
+}
+
+AudioFile::~AudioFile()
+{
+    if (map_)
+        munmap((void *)map_, map_size_);
+}
+
+bool AudioFile::Open(const char *path, float raw_sample_rate)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        KALDI_WARN << "Can't open " << path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        KALDI_WARN << "Can't read " << path;
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        KALDI_WARN << "Can't map " << path;
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    map_ = (const char *)map;
+    map_size_ = st.st_size;
+
+    if (map_size_ >= 12 && memcmp(map_, "RIFF", 4) == 0 && memcmp(map_ + 8, "WAVE", 4) == 0) {
+        if (!ParseWav()) {
+            KALDI_WARN << "Unsupported WAV file " << path;
+            return false;
+        }
+    } else {
+        data_ = map_;
+        num_frames_ = map_size_ / 2;
+        sample_rate_ = raw_sample_rate;
+    }
+
+    if (!(sample_rate_ >= AUDIO_FILE_MIN_RATE && sample_rate_ <= AUDIO_FILE_MAX_RATE)) {
+        KALDI_WARN << "Unsupported sample rate " << sample_rate_ << " of " << path;
+        return false;
+    }
+    return true;
+}
+
+bool AudioFile::ParseWav()
+{
+    const char *p = map_ + 12, *end = map_ + map_size_;
+    bool have_format = false;
+
+    while (p + 8 <= end) {
+        uint32_t chunk_len;
+        memcpy(&chunk_len, p + 4, 4);
+        const char *body = p + 8;
+
+        if (memcmp(p, "fmt ", 4) == 0 && chunk_len >= 16 && body + 16 <= end) {
+            uint16_t format, channels, bits;
+            uint32_t rate;
+            memcpy(&format, body, 2);
+            memcpy(&channels, body + 2, 2);
+            memcpy(&rate, body + 4, 4);
+            memcpy(&bits, body + 14, 2);
+            // WAVE_FORMAT_EXTENSIBLE keeps the actual format in the subformat GUID
+            if (format == 0xFFFE && chunk_len >= 26 && body + 26 <= end)
+                memcpy(&format, body + 24, 2);
+
+            if (!(format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) &&
+                !(format == 3 && bits == 32))
+                return false;
+            if (channels == 0)
+                return false;
+
+            channels_ = channels;
+            sample_width_ = bits / 8;
+            float_samples_ = format == 3;
+            sample_rate_ = rate;
+            have_format = true;
+        } else if (memcmp(p, "data", 4) == 0) {
+            if (!have_format)
+                return false;
+            size_t len = end - body < (ptrdiff_t)chunk_len ? end - body : chunk_len;
+            data_ = body;
+            num_frames_ = len / (channels_ * sample_width_);
+            return true;
+        }
+        p = body + chunk_len + (chunk_len & 1);
+    }
+    return false;
+}
+
+static float ReadSample(const unsigned char *p, int width, bool float_samples)
+{
+    switch (width) {
+    case 1:
+        return (p[0] - 128) * 256.0f;
+    case 2: {
+        int16_t v;
+        memcpy(&v, p, 2);
+        return v;
+    }
+    case 3:
+        return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) / 65536.0f;
+    default:
+        if (float_samples) {
+            float v;
+            memcpy(&v, p, 4);
+            return v * 32768.0f;
+        } else {
+            int32_t v;
+            memcpy(&v, p, 4);
+            return v / 65536.0f;
+        }
+    }
+}
+
+int AudioFile::Feed(VoskRecognizer *recognizer)
+{
+    if (pos_ >= num_frames_)
+        return -1;
+
+    size_t chunk = sample_rate_ * AUDIO_FILE_CHUNK_SEC;
+    size_t len = num_frames_ - pos_ < chunk ? num_frames_ - pos_ : chunk;
+    size_t frame_size = channels_ * sample_width_;
+    const char *frames = data_ + pos_ * frame_size;
+    int endpoint;
+
+    if (channels_ == 1 && sample_width_ == 2 && ((uintptr_t)frames & 1) == 0) {
+        endpoint = vosk_recognizer_accept_waveform_s(recognizer, (const short *)frames, len);
+    } else {
+        buffer_.resize(len);
+        for (size_t i = 0; i < len; i++) {
+            const unsigned char *frame = (const unsigned char *)frames + i * frame_size;
+            float sum = 0;
+            for (int c = 0; c < channels_; c++)
+                sum += ReadSample(frame + c * sample_width_, sample_width_, float_samples_);
+            buffer_[i] = sum / channels_;
+        }
+        endpoint = vosk_recognizer_accept_waveform_f(recognizer, buffer_.data(), len);
+    }
+
+    pos_ += len;
+    return endpoint;
+}
@@ -0,0 +1,61 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AUDIO_FILE_H_
+#define AUDIO_FILE_H_
+
+#include "vosk_api.h"
+
+#include <stddef.h>
+#include <vector>
+
+// Audio file mapped into memory
+//
+// WAV files with 8, 16, 24 or 32-bit integer or 32-bit float samples and
+// any number of channels are supported, raw files are 16-bit mono PCM.
+// Mono 16-bit data is passed to the recognizer straight from the mapping,
+// other formats are converted chunk by chunk to mono samples in 16-bit
+// range.
+class AudioFile {
+
+public:
+    AudioFile();
+    ~AudioFile();
+
+    // Sample rate is used for raw files, WAV files carry their own
+    bool Open(const char *path, float raw_sample_rate);
+    float SampleRate() const { return sample_rate_; };
+
+    // Feeds the next chunk, returns 1 if it ends an utterance, 0 if not
+    // and -1 once the whole file is fed
+    int Feed(VoskRecognizer *recognizer);
+
+private:
+    bool ParseWav();
+
+    const char *map_;
+    size_t map_size_;
+    const char *data_;
+    size_t num_frames_;
+    size_t pos_;
+
+    float sample_rate_;
+    int channels_;
+    int sample_width_;
+    bool float_samples_;
+
+    std::vector<float> buffer_;
+};
+
+#endif /* AUDIO_FILE_H_ */
@@ -0,0 +1,48 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BUILD_OPTIONS_H_
+#define BUILD_OPTIONS_H_
+
+// Optional subsystems, defining the macro compiles the subsystem out
+//
+//   VOSK_DISABLE_RESCORE    lattice rescoring with rescore/G.fst and G.carpa,
+//                           the rescoring files of a model are ignored
+//   VOSK_DISABLE_SPEAKER    speaker models, vosk_spk_model_new returns NULL
+//   VOSK_DISABLE_LOOKAHEAD  HCLr/Gr graphs composed on the fly and the NGramFst
+//                           and lookahead FST types, models need HCLG.fst and
+//                           grammar recognizers fail to create
+//
+// Code that must not reference the subsystem symbols is guarded with the
+// macros, the constants below serve plain conditions.
+
+#ifdef VOSK_DISABLE_RESCORE
+static constexpr bool kVoskRescore = false;
+#else
+static constexpr bool kVoskRescore = true;
+#endif
+
+#ifdef VOSK_DISABLE_SPEAKER
+static constexpr bool kVoskSpeaker = false;
+#else
+static constexpr bool kVoskSpeaker = true;
+#endif
+
+#ifdef VOSK_DISABLE_LOOKAHEAD
+static constexpr bool kVoskLookahead = false;
+#else
+static constexpr bool kVoskLookahead = true;
+#endif
+
+#endif /* BUILD_OPTIONS_H_ */
@@ -0,0 +1,176 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fd_reader.h"
+
+#include "base/kaldi-common.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+// Chunk duration fed per call, see AUDIO_FILE_CHUNK_SEC
+#define FD_READER_CHUNK_SEC 0.2
+// Size of the block requested from the descriptor, in chunks
+#define FD_READER_BLOCK_CHUNKS 5
+
+FdReader::FdReader(VoskRecognizer *recognizer, float sample_rate, int fd, VoskAudioFormat format,
+                   VoskResultCallback callback, void *user_data, bool partial_results) :
+    recognizer_(recognizer), sample_rate_(sample_rate), fd_(fd), format_(format),
+    callback_(callback), user_data_(user_data), partial_results_(partial_results), pending_(0)
+{
+}
+
+// Reads up to len bytes, with full set keeps reading until len bytes or
+// the end of input
+ssize_t FdReader::Read(char *buf, size_t len, bool full)
+{
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = read(fd_, buf + total, len - total);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        if (n == 0)
+            break;
+        total += n;
+        if (!full)
+            break;
+    }
+    return total;
+}
+
+// Skips the WAV header of the stream. The first 12 bytes are in the
+// buffer, if they are not a WAV header they are kept as audio data.
+bool FdReader::ReadWavHeader()
+{
+    if (pending_ < 12 || memcmp(buffer_.data(), "RIFF", 4) != 0 || memcmp(buffer_.data() + 8, "WAVE", 4) != 0)
+        return true;
+    pending_ = 0;
+
+    char chunk[8];
+    bool have_format = false;
+    while (true) {
+        if (Read(chunk, 8, true) != 8) {
+            KALDI_WARN << "WAV data chunk is missing";
+            return false;
+        }
+        uint32_t chunk_len;
+        memcpy(&chunk_len, chunk + 4, 4);
+        if (memcmp(chunk, "data", 4) == 0)
+            break;
+
+        std::vector<char> body(chunk_len + (chunk_len & 1));
+        if (Read(body.data(), body.size(), true) != (ssize_t)body.size()) {
+            KALDI_WARN << "Truncated WAV header";
+            return false;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_len >= 16) {
+            uint16_t format, channels, bits;
+            uint32_t rate;
+            memcpy(&format, &body[0], 2);
+            memcpy(&channels, &body[2], 2);
+            memcpy(&rate, &body[4], 4);
+            memcpy(&bits, &body[14], 2);
+            if (format != 1 || channels != 1 || bits != 16) {
+                KALDI_WARN << "Audio must be 16-bit mono PCM";
+                return false;
+            }
+            if (rate != sample_rate_) {
+                KALDI_WARN << "Audio sample rate " << rate << " doesn't match the recognizer rate " << sample_rate_;
+                return false;
+            }
+            have_format = true;
+        }
+    }
+    if (!have_format) {
+        KALDI_WARN << "WAV format chunk is missing";
+        return false;
+    }
+    return true;
+}
+
+void FdReader::Deliver(VoskResultType type, const char *result)
+{
+    if (callback_)
+        callback_(user_data_, type, result);
+}
+
+void FdReader::Feed(char *data, size_t len)
+{
+    int endpoint;
+    if (format_ == VOSK_FORMAT_F32LE) {
+        // Normalized float samples are scaled to 16-bit range
+        float *fdata = (float *)data;
+        for (size_t i = 0; i < len / sizeof(float); i++)
+            fdata[i] *= 32768.0f;
+        endpoint = vosk_recognizer_accept_waveform_f(recognizer_, fdata, len / sizeof(float));
+    } else {
+        endpoint = vosk_recognizer_accept_waveform_s(recognizer_, (const short *)data, len / sizeof(short));
+    }
+
+    // Results are retrieved even without a callback to collect the metadata
+    if (endpoint)
+        Deliver(VOSK_RESULT_UTTERANCE, vosk_recognizer_result(recognizer_));
+    else if (partial_results_ && callback_)
+        Deliver(VOSK_RESULT_PARTIAL, vosk_recognizer_partial_result(recognizer_));
+}
+
+int FdReader::Run()
+{
+    size_t sample_size = format_ == VOSK_FORMAT_F32LE ? sizeof(float) : sizeof(short);
+    size_t chunk = (size_t)(sample_rate_ * FD_READER_CHUNK_SEC) * sample_size;
+    int status = 0;
+
+    buffer_.resize(chunk * FD_READER_BLOCK_CHUNKS);
+
+    if (format_ == VOSK_FORMAT_AUTO) {
+        ssize_t n = Read(buffer_.data(), 12, true);
+        if (n < 0) {
+            KALDI_WARN << "Can't read audio: " << strerror(errno);
+            status = -1;
+        } else {
+            pending_ = n;
+            if (!ReadWavHeader())
+                status = -1;
+        }
+    }
+
+    while (status == 0) {
+        ssize_t n = Read(buffer_.data() + pending_, buffer_.size() - pending_, false);
+        if (n < 0) {
+            KALDI_WARN << "Can't read audio: " << strerror(errno);
+            status = -1;
+            break;
+        }
+        if (n == 0)
+            break;
+        pending_ += n;
+
+        size_t fed = 0;
+        for (; pending_ - fed >= chunk; fed += chunk)
+            Feed(buffer_.data() + fed, chunk);
+        memmove(buffer_.data(), buffer_.data() + fed, pending_ - fed);
+        pending_ -= fed;
+    }
+
+    if (status == 0 && pending_ >= sample_size)
+        Feed(buffer_.data(), pending_ - pending_ % sample_size);
+    pending_ = 0;
+
+    Deliver(VOSK_RESULT_FINAL, vosk_recognizer_final_result(recognizer_));
+    return status;
+}
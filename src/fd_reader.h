@@ -0,0 +1,56 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FD_READER_H_
+#define FD_READER_H_
+
+#include "vosk_api.h"
+
+#include <sys/types.h>
+#include <vector>
+
+// Feeds audio read from a file descriptor to a recognizer
+//
+// The descriptor is read in large blocks until the end of input, complete
+// chunks are fed as soon as they are available so live sources like pipes
+// and sockets keep a low latency. Results are delivered to the callback,
+// the final result always comes last.
+class FdReader {
+
+public:
+    FdReader(VoskRecognizer *recognizer, float sample_rate, int fd, VoskAudioFormat format,
+             VoskResultCallback callback, void *user_data, bool partial_results);
+
+    // Returns 0 at the end of input, -1 on read error or unsupported format
+    int Run();
+
+private:
+    bool ReadWavHeader();
+    ssize_t Read(char *buf, size_t len, bool full);
+    void Feed(char *data, size_t len);
+    void Deliver(VoskResultType type, const char *result);
+
+    VoskRecognizer *recognizer_;
+    float sample_rate_;
+    int fd_;
+    VoskAudioFormat format_;
+    VoskResultCallback callback_;
+    void *user_data_;
+    bool partial_results_;
+
+    std::vector<char> buffer_;
+    size_t pending_;
+};
+
+#endif /* FD_READER_H_ */
@@ -0,0 +1,278 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "fingerprint_cache.h"
+#include "metrics.h"
+#include "json.h"
+
+#include <algorithm>
+
+#define FINGERPRINT_FRAME_SEC 0.128
+#define FINGERPRINT_HOPS_PER_FRAME 16
+#define FINGERPRINT_BANDS 17
+#define FINGERPRINT_BITS (FINGERPRINT_BANDS - 1)
+#define FINGERPRINT_LOW_HZ 300.0
+#define FINGERPRINT_HIGH_HZ 3000.0
+
+// Alignments verified per lookup and the votes they need as a fraction
+// of the block subfingerprints
+#define FINGERPRINT_CANDIDATES 4
+#define FINGERPRINT_MIN_VOTES 0.05
+
+// Values more frequent than this in the index carry no information
+#define FINGERPRINT_MAX_BUCKET 1000
+
+Fingerprinter::Fingerprinter(BaseFloat sample_rate) :
+    sample_rate_(sample_rate), num_frames_(0)
+{
+    frame_length_ = RoundUpToNearestPowerOfTwo(sample_rate * FINGERPRINT_FRAME_SEC);
+    hop_ = frame_length_ / FINGERPRINT_HOPS_PER_FRAME;
+    fft_ = new SplitRadixRealFft<BaseFloat>(frame_length_);
+
+    window_.resize(frame_length_);
+    for (int i = 0; i < frame_length_; i++)
+        window_[i] = 0.5 - 0.5 * cos(M_2PI * i / frame_length_);
+
+    // Log-spaced bands, each at least one bin wide
+    BaseFloat high = std::min(FINGERPRINT_HIGH_HZ, 0.45 * sample_rate);
+    BaseFloat bin_hz = sample_rate / frame_length_;
+    band_bins_.resize(FINGERPRINT_BANDS + 1);
+    for (int b = 0; b <= FINGERPRINT_BANDS; b++) {
+        BaseFloat hz = FINGERPRINT_LOW_HZ * pow(high / FINGERPRINT_LOW_HZ, (BaseFloat)b / FINGERPRINT_BANDS);
+        band_bins_[b] = std::max((int)(hz / bin_hz + 0.5), 1);
+        if (b > 0 && band_bins_[b] <= band_bins_[b - 1])
+            band_bins_[b] = band_bins_[b - 1] + 1;
+    }
+    if (band_bins_[FINGERPRINT_BANDS] > frame_length_ / 2)
+        KALDI_ERR << "Sample rate " << sample_rate << " is too low for fingerprinting";
+
+    frame_.resize(frame_length_);
+    energy_.resize(FINGERPRINT_BANDS);
+}
+
+Fingerprinter::~Fingerprinter()
+{
+    delete fft_;
+}
+
+int64 Fingerprinter::Compute(const BaseFloat *data, size_t len, vector<uint32> *fingerprint)
+{
+    samples_.insert(samples_.end(), data, data + len);
+    int64 first = num_frames_ > 0 ? num_frames_ : 1;
+
+    size_t pos = 0;
+    while (samples_.size() - pos >= (size_t)frame_length_) {
+        for (int i = 0; i < frame_length_; i++)
+            frame_[i] = samples_[pos + i] * window_[i];
+        fft_->Compute(frame_.data(), true);
+
+        // Packed output, real and imaginary parts of bin k at 2k and 2k + 1
+        for (int b = 0; b < FINGERPRINT_BANDS; b++) {
+            BaseFloat e = 0;
+            for (int k = band_bins_[b]; k < band_bins_[b + 1]; k++)
+                e += frame_[2 * k] * frame_[2 * k] + frame_[2 * k + 1] * frame_[2 * k + 1];
+            energy_[b] = e;
+        }
+
+        if (num_frames_ > 0) {
+            uint32 bits = 0;
+            for (int b = 0; b < FINGERPRINT_BITS; b++) {
+                BaseFloat diff = (energy_[b] - energy_[b + 1]) - (prev_energy_[b] - prev_energy_[b + 1]);
+                if (diff > 0)
+                    bits |= 1u << b;
+            }
+            fingerprint->push_back(bits);
+        }
+        prev_energy_.swap(energy_);
+        energy_.resize(FINGERPRINT_BANDS);
+        num_frames_++;
+        pos += hop_;
+    }
+    samples_.erase(samples_.begin(), samples_.begin() + pos);
+    return first;
+}
+
+FingerprintCache::FingerprintCache(const FingerprintCacheConfig &config) :
+    config_(config), num_frames_(0), lookups_(0), hits_(0), reused_words_(0),
+    skipped_seconds_(0), stored_seconds_(0)
+{
+    // Hops are 8 ms for the usual 8 and 16 kHz audio
+    max_frames_ = config.max_duration / (FINGERPRINT_FRAME_SEC / FINGERPRINT_HOPS_PER_FRAME);
+}
+
+bool FingerprintCache::Contiguous(const Location &first, size_t len, int sample_rate)
+{
+    auto it = streams_.find(first.stream);
+    if (it == streams_.end())
+        return false;
+    const Stream &stream = it->second;
+    if (stream.sample_rate != sample_rate || first.offset < stream.first_offset ||
+        first.offset - stream.first_offset + len > stream.frames.size())
+        return false;
+    const Frame &start = stream.frames[first.offset - stream.first_offset];
+    const Frame &end = stream.frames[first.offset - stream.first_offset + len - 1];
+    // Blocks skipped by the stream leave a gap in the times
+    return fabs(end.time - start.time - (len - 1) * stream.hop) < stream.hop / 2;
+}
+
+bool FingerprintCache::Lookup(int sample_rate, const vector<uint32> &fingerprint, double start,
+                              vector<FingerprintWord> *words)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t len = fingerprint.size();
+    if (len == 0)
+        return false;
+    lookups_++;
+
+    unordered_map<Location, int, LocationHash> votes;
+    for (size_t i = 0; i < len; i++) {
+        auto it = index_.find(fingerprint[i]);
+        if (it == index_.end() || it->second.size() > FINGERPRINT_MAX_BUCKET)
+            continue;
+        for (const Location &location : it->second) {
+            Location first = { location.stream, location.offset - (int64)i };
+            votes[first]++;
+        }
+    }
+
+    vector<pair<int, Location> > candidates;
+    int min_votes = std::max((int)(len * FINGERPRINT_MIN_VOTES), 2);
+    for (auto &v : votes) {
+        if (v.second >= min_votes)
+            candidates.push_back(make_pair(v.second, v.first));
+    }
+    size_t num_candidates = std::min(candidates.size(), (size_t)FINGERPRINT_CANDIDATES);
+    std::partial_sort(candidates.begin(), candidates.begin() + num_candidates, candidates.end(),
+                      [](const pair<int, Location> &a, const pair<int, Location> &b) {
+                          return a.first > b.first;
+                      });
+
+    size_t max_errors = config_.max_bit_error_rate * FINGERPRINT_BITS * len;
+    for (size_t c = 0; c < num_candidates; c++) {
+        const Location &first = candidates[c].second;
+        if (!Contiguous(first, len, sample_rate))
+            continue;
+
+        const Stream &stream = streams_[first.stream];
+        size_t pos = first.offset - stream.first_offset;
+        size_t errors = 0;
+        for (size_t i = 0; i < len && errors <= max_errors; i++)
+            errors += __builtin_popcount(fingerprint[i] ^ stream.frames[pos + i].value);
+        if (errors > max_errors)
+            continue;
+
+        double match_start = stream.frames[pos].time;
+        double match_end = match_start + len * stream.hop;
+        hits_++;
+        skipped_seconds_ += len * stream.hop;
+        Metrics::Get().AddFingerprintLookup(true);
+
+        for (const FingerprintWord &w : stream.words) {
+            if (w.start >= match_start && w.start < match_end) {
+                FingerprintWord word = w;
+                word.start += start - match_start;
+                word.end += start - match_start;
+                words->push_back(word);
+            }
+        }
+        reused_words_ += words->size();
+        return true;
+    }
+
+    Metrics::Get().AddFingerprintLookup(false);
+    return false;
+}
+
+void FingerprintCache::Add(int stream_id, int sample_rate, double start, BaseFloat hop,
+                           const vector<uint32> &fingerprint)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fingerprint.empty())
+        return;
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        it = streams_.insert(make_pair(stream_id, Stream())).first;
+        it->second.first_offset = 0;
+    }
+    Stream &stream = it->second;
+    stream.sample_rate = sample_rate;
+    stream.hop = hop;
+
+    for (size_t i = 0; i < fingerprint.size(); i++) {
+        Frame frame = { fingerprint[i], start + i * hop };
+        Location location = { stream_id, stream.first_offset + (int64)stream.frames.size() };
+        index_[frame.value].push_back(location);
+        stream.frames.push_back(frame);
+    }
+    added_.push_back(make_pair(stream_id, fingerprint.size()));
+    num_frames_ += fingerprint.size();
+    stored_seconds_ += fingerprint.size() * hop;
+    Evict();
+}
+
+void FingerprintCache::AddWords(int stream_id, const vector<FingerprintWord> &words)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end())
+        return;
+    it->second.words.insert(it->second.words.end(), words.begin(), words.end());
+}
+
+// Frames are dropped in the order they were added, across all streams, so
+// the oldest entry of each index bucket is always the one dropped
+void FingerprintCache::Evict()
+{
+    while (num_frames_ > max_frames_) {
+        pair<int32, size_t> &run = added_.front();
+        Stream &stream = streams_[run.first];
+        const Frame &frame = stream.frames.front();
+
+        auto it = index_.find(frame.value);
+        it->second.pop_front();
+        if (it->second.empty())
+            index_.erase(it);
+
+        // Words are only looked up within the stored audio
+        while (!stream.words.empty() && stream.words.front().start < frame.time + stream.hop)
+            stream.words.pop_front();
+
+        stored_seconds_ -= stream.hop;
+        stream.frames.pop_front();
+        stream.first_offset++;
+        num_frames_--;
+
+        if (stream.frames.empty())
+            streams_.erase(run.first);
+        if (--run.second == 0)
+            added_.pop_front();
+    }
+}
+
+const char *FingerprintCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    json::JSON stats;
+    stats["lookups"] = lookups_;
+    stats["hits"] = hits_;
+    stats["hit_rate"] = lookups_ > 0 ? (double)hits_ / lookups_ : 0.0;
+    stats["reused_words"] = reused_words_;
+    stats["skipped_seconds"] = skipped_seconds_;
+    stats["stored_seconds"] = stored_seconds_;
+    // Every thread gets its own copy, other callers may render meanwhile
+    static thread_local string stats_text;
+    stats_text = stats.dump();
+    return stats_text.c_str();
+}
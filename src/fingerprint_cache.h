@@ -0,0 +1,180 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef FINGERPRINT_CACHE_H_
+#define FINGERPRINT_CACHE_H_
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "matrix/srfft.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace kaldi;
+using namespace std;
+
+// Skips decoding of audio heard before, like hold music and recorded
+// prompts, see FingerprintCache
+struct FingerprintCacheConfig {
+    bool enabled;
+    BaseFloat block_duration;
+    BaseFloat max_duration;
+    BaseFloat max_bit_error_rate;
+    BaseFloat min_rms;
+    bool reuse_words;
+
+    FingerprintCacheConfig() : enabled(false), block_duration(1.0), max_duration(900),
+        max_bit_error_rate(0.15), min_rms(100), reuse_words(true) { }
+
+    void Register(OptionsItf *opts) {
+        opts->Register("fingerprint-cache.enabled", &enabled, "If true, audio blocks "
+                       "matching recently decoded audio are not decoded again");
+        opts->Register("fingerprint-cache.block-duration", &block_duration, "Duration in "
+                       "seconds of the blocks looked up, audio is delayed by up to a block");
+        opts->Register("fingerprint-cache.max-duration", &max_duration, "Seconds of "
+                       "decoded audio kept in the cache, shared by all recognizers of the model");
+        opts->Register("fingerprint-cache.max-bit-error-rate", &max_bit_error_rate,
+                       "Maximum fraction of fingerprint bits that may differ on a match");
+        opts->Register("fingerprint-cache.min-rms", &min_rms, "Blocks quieter than "
+                       "this RMS in 16-bit sample units are always decoded");
+        opts->Register("fingerprint-cache.reuse-words", &reuse_words, "If true, the "
+                       "words decoded for the matching audio are reported for skipped blocks");
+    }
+};
+
+// Streaming audio fingerprint
+//
+// Frames of about 128 ms are taken with a hop of 1/16 frame, each frame
+// after the first gives a 16-bit subfingerprint from the signs of the
+// energy differences of adjacent bands between 300 and 3000 Hz and their
+// change from the previous frame. Identical audio gives identical bits
+// regardless of the level, the long overlapping frames keep the bits
+// stable when the audio is misaligned with the hops.
+class Fingerprinter {
+
+public:
+    Fingerprinter(BaseFloat sample_rate);
+    ~Fingerprinter();
+
+    // Appends the subfingerprints of the frames completed by the data,
+    // returns the index of the first one
+    int64 Compute(const BaseFloat *data, size_t len, vector<uint32> *fingerprint);
+    // Start time in seconds of the frame from the beginning of the stream
+    double FrameTime(int64 frame) const { return (double)frame * hop_ / sample_rate_; };
+    BaseFloat HopDuration() const { return hop_ / sample_rate_; };
+
+private:
+    BaseFloat sample_rate_;
+    int frame_length_;
+    int hop_;
+    vector<int> band_bins_;
+    vector<BaseFloat> window_;
+    vector<BaseFloat> samples_;
+    vector<BaseFloat> frame_;
+    vector<BaseFloat> energy_;
+    vector<BaseFloat> prev_energy_;
+    int64 num_frames_;
+    SplitRadixRealFft<BaseFloat> *fft_;
+};
+
+struct FingerprintWord {
+    string word;
+    double start;
+    double end;
+    BaseFloat conf;
+};
+
+// Fingerprints and words of recently decoded audio, shared by the
+// recognizers of a model
+//
+// Subfingerprints are stored per stream and indexed by value, a block is
+// looked up by voting for the stream offsets its subfingerprints suggest
+// and comparing the best ones bit by bit against the stored stream, so a
+// block matches across the boundaries of the blocks stored by another
+// recognizer even when many recognizers add audio at the same time. The
+// oldest audio is dropped once the cache holds max-duration seconds.
+class FingerprintCache {
+
+public:
+    FingerprintCache(const FingerprintCacheConfig &config);
+
+    // On a hit returns the words decoded for the matching audio, with
+    // times shifted to the block starting at start
+    bool Lookup(int sample_rate, const vector<uint32> &fingerprint, double start,
+                vector<FingerprintWord> *words);
+    void Add(int stream, int sample_rate, double start, BaseFloat hop,
+             const vector<uint32> &fingerprint);
+    void AddWords(int stream, const vector<FingerprintWord> &words);
+
+    // JSON with the lookup and hit counts, the hit rate and the audio
+    // skipped and stored, valid until the next call from the same thread
+    const char *GetStats();
+
+private:
+    struct Frame {
+        uint32 value;
+        double time;
+    };
+
+    // Frames of a stream in the order they were added, offsets count the
+    // frames from the beginning of the stream so evictions don't move them
+    struct Stream {
+        int32 sample_rate;
+        BaseFloat hop;
+        int64 first_offset;
+        deque<Frame> frames;
+        deque<FingerprintWord> words;
+    };
+
+    struct Location {
+        int32 stream;
+        int64 offset;
+        bool operator==(const Location &other) const {
+            return stream == other.stream && offset == other.offset;
+        }
+    };
+
+    struct LocationHash {
+        size_t operator()(const Location &location) const {
+            return std::hash<int64>()(location.offset * 1000003 + location.stream);
+        }
+    };
+
+    bool Contiguous(const Location &first, size_t len, int sample_rate);
+    void Evict();
+
+    FingerprintCacheConfig config_;
+    std::mutex mutex_;
+
+    unordered_map<int32, Stream> streams_;
+    unordered_map<uint32, deque<Location> > index_;
+    // Streams of the added runs of frames, oldest first, for eviction
+    deque<pair<int32, size_t> > added_;
+    size_t num_frames_;
+    size_t max_frames_;
+
+    int64 lookups_;
+    int64 hits_;
+    int64 reused_words_;
+    double skipped_seconds_;
+    double stored_seconds_;
+};
+
+#endif /* FINGERPRINT_CACHE_H_ */
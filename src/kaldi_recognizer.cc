@@ -28,9 +28,14 @@
 using namespace fst;
 using namespace kaldi::nnet3;
 
+// Cache size of the rescoring LM map
+#define LM_FST_CACHE_SIZE 50000
+
 KaldiRecognizer::KaldiRecognizer(Model *model, SpkModel *spk_model, float sample_frequency, bool online) : model_(model), spk_model_(spk_model), sample_frequency_(sample_frequency), online_(online) {
 
     model_->Ref();
+    stream_id_ = Tracer::Get().NewStreamId();
+    recorder = NULL;
 
     if (online_) {
         model_->feature_info_->ivector_extractor_info.use_most_recent_ivector = true;
@@ -47,11 +52,15 @@ KaldiRecognizer::KaldiRecognizer(Model *model, SpkModel *spk_model, float sample
     decode_fst_ = NULL;
 
     if (!model_->hclg_fst_) {
+#ifndef VOSK_DISABLE_LOOKAHEAD
         if (model_->hcl_fst_ && model_->g_fst_) {
             decode_fst_ = LookaheadComposeFst(*model_->hcl_fst_, *model_->g_fst_, model_->disambig_);
         } else {
             KALDI_ERR << "Can't create decoding graph";
         }
+#else
+        KALDI_ERR << "Can't create decoding graph";
+#endif
     }
 
     decoder_ = new kaldi::SingleUtteranceNnet3Decoder(model_->nnet3_decoding_config_,
@@ -61,19 +70,28 @@ KaldiRecognizer::KaldiRecognizer(Model *model, SpkModel *spk_model, float sample
             feature_pipeline_);
 
 
+#ifndef VOSK_DISABLE_SPEAKER
     if (spk_model_)
         spk_feature_ = new OnlineMfcc(spk_model_->spkvector_mfcc_opts);
     else
         spk_feature_ = NULL;
+#else
+    spk_feature_ = NULL;
+#endif
 
 
     InitState();
     InitRescoring();
+
+    // Counted only once nothing can throw, the destructor doesn't run then
+    Metrics::Get().RecognizerCreated();
 }
 
 KaldiRecognizer::KaldiRecognizer(Model *model, float sample_frequency, char const *grammar, bool online) : model_(model), spk_model_(0), sample_frequency_(sample_frequency), online_(online){
     
     model_->Ref();
+    stream_id_ = Tracer::Get().NewStreamId();
+    recorder = NULL;
 
     if (online_) {
         model_->feature_info_->ivector_extractor_info.use_most_recent_ivector = true;
@@ -86,6 +104,7 @@ KaldiRecognizer::KaldiRecognizer(Model *model, float sample_frequency, char cons
     feature_pipeline_->SetAdaptationState(*model_->adaptation_state_);
     feature_pipeline_->SetCmvnState(*model_->cmvn_state_);
 
+#ifndef VOSK_DISABLE_LOOKAHEAD
     g_fst_ = new StdVectorFst();
     if (model_->hcl_fst_) {
         g_fst_->AddState();
@@ -113,6 +132,11 @@ KaldiRecognizer::KaldiRecognizer(Model *model, float sample_frequency, char cons
         decode_fst_ = NULL;
         KALDI_ERR << "Can't create decoding graph";
     }
+#else
+    g_fst_ = NULL;
+    decode_fst_ = NULL;
+    KALDI_ERR << "Built without lookahead composition, grammar is not supported";
+#endif
 
     decoder_ = new kaldi::SingleUtteranceNnet3Decoder(model_->nnet3_decoding_config_,
             *model_->trans_model_,
@@ -124,6 +148,9 @@ KaldiRecognizer::KaldiRecognizer(Model *model, float sample_frequency, char cons
 
     InitState();
     InitRescoring();
+
+    // Counted only once nothing can throw, the destructor doesn't run then
+    Metrics::Get().RecognizerCreated();
 }
 
 KaldiRecognizer::~KaldiRecognizer() {
@@ -134,6 +161,7 @@ KaldiRecognizer::~KaldiRecognizer() {
     delete decode_fst_;
     delete spk_feature_;
     delete lm_fst_;
+    delete fingerprinter_;
 
     decoder_ = NULL;
     feature_pipeline_ = NULL;
@@ -143,6 +171,11 @@ KaldiRecognizer::~KaldiRecognizer() {
     spk_feature_ = NULL;
     metadata_ = NULL;
 
+    delete recorder;
+    recorder = NULL;
+
+    Metrics::Get().RecognizerReleased();
+
     model_->Unref();
     if (spk_model_)
          spk_model_->Unref();
@@ -153,14 +186,25 @@ void KaldiRecognizer::InitState()
     frame_offset_ = 0;
     samples_processed_ = 0;
     samples_round_start_ = 0;
+    utt_samples_ = 0;
+    utt_decode_time_ = 0;
+    stable_words_.clear();
+    stable_since_ = 0;
+    stable_checked_ = 0;
+    grammar_final_since_ = -1;
+
+    fingerprinter_ = model_->fingerprint_cache_ ? new Fingerprinter(sample_frequency_) : NULL;
+    cache_skipped_samples_ = 0;
+
+    index_writer_ = NULL;
 
     state_ = RECOGNIZER_INITIALIZED;
 }
 
 void KaldiRecognizer::InitRescoring()
 {
-    if (model_->std_lm_fst_) {
-        fst::CacheOptions cache_opts(true, 50000);
+    if (kVoskRescore && model_->std_lm_fst_) {
+        fst::CacheOptions cache_opts(true, LM_FST_CACHE_SIZE);
         fst::MapFstOptions mapfst_opts(cache_opts);
         fst::StdToLatticeMapper<kaldi::BaseFloat> mapper;
         lm_fst_ = new fst::MapFst<fst::StdArc, kaldi::LatticeArc, fst::StdToLatticeMapper<kaldi::BaseFloat> >(*model_->std_lm_fst_, mapper, mapfst_opts);
@@ -174,23 +218,34 @@ void KaldiRecognizer::CleanUp()
     delete silence_weighting_;
     silence_weighting_ = new kaldi::OnlineSilenceWeighting(*model_->trans_model_, model_->feature_info_->silence_weighting_config, 3);
 
+#ifndef VOSK_DISABLE_SPEAKER
     if (spk_model_) {
         delete spk_feature_;
         spk_feature_ = new OnlineMfcc(spk_model_->spkvector_mfcc_opts);
     }
+#endif
 
     if (decoder_)
        frame_offset_ += decoder_->NumFramesDecoded();
 
+    stable_words_.clear();
+    stable_since_ = 0;
+    stable_checked_ = 0;
+    grammar_final_since_ = -1;
+
     // Each 10 minutes we drop the pipeline to save frontend memory in continuous processing
     // here we drop few frames remaining in the feature pipeline but hope it will not
     // cause a huge accuracy drop since it happens not very frequently.
 
     // Also restart if we retrieved final result already
 
-    if (decoder_ == NULL || state_ == RECOGNIZER_FINALIZED || frame_offset_ > 20000) {
-        samples_round_start_ += samples_processed_;
+    // Audio skipped by the fingerprint cache breaks the feature continuity,
+    // restart to move the timeline past it
+
+    if (decoder_ == NULL || state_ == RECOGNIZER_FINALIZED || frame_offset_ > 20000 || cache_skipped_samples_ > 0) {
+        samples_round_start_ += samples_processed_ + cache_skipped_samples_;
         samples_processed_ = 0;
+        cache_skipped_samples_ = 0;
         frame_offset_ = 0;
 
         delete decoder_;
@@ -272,6 +327,75 @@ bool KaldiRecognizer::AcceptWaveform(const float *fdata, int len)
 
 bool KaldiRecognizer::AcceptWaveform(Vector<BaseFloat> &wdata)
 {
+    if (fingerprinter_)
+        return AcceptCached(wdata);
+    return DecodeWaveform(wdata);
+}
+
+// Audio is looked up in the fingerprint cache block by block. Blocks heard
+// before are not decoded, when the utterance before them has audio they
+// end it, so its result comes with the words of the skipped block.
+bool KaldiRecognizer::AcceptCached(Vector<BaseFloat> &wdata)
+{
+    TraceSpan span("AcceptCached", stream_id_);
+    FingerprintCache *cache = model_->fingerprint_cache_;
+    const FingerprintCacheConfig &config = model_->fingerprint_cache_config_;
+    size_t block = config.block_duration * sample_frequency_;
+
+    cache_buffer_.insert(cache_buffer_.end(), wdata.Data(), wdata.Data() + wdata.Dim());
+
+    bool endpoint = false;
+    size_t pos = 0;
+    while (!endpoint && cache_buffer_.size() - pos >= block) {
+        const BaseFloat *data = cache_buffer_.data() + pos;
+        pos += block;
+
+        vector<uint32> fingerprint;
+        int64 first_frame;
+        double energy = 0;
+        {
+            TraceSpan span("Fingerprint", stream_id_);
+            first_frame = fingerprinter_->Compute(data, block, &fingerprint);
+            for (size_t i = 0; i < block; i++)
+                energy += data[i] * data[i];
+        }
+        bool audible = sqrt(energy / block) >= config.min_rms;
+        double start = fingerprinter_->FrameTime(first_frame);
+
+        vector<FingerprintWord> words;
+        if (audible && cache->Lookup(sample_frequency_, fingerprint, start, &words)) {
+            Metrics::Get().AddAudio(block, sample_frequency_);
+            cache_skipped_samples_ += block;
+            if (config.reuse_words)
+                cache_words_.insert(cache_words_.end(), words.begin(), words.end());
+
+            if (state_ == RECOGNIZER_RUNNING && utt_samples_ > 0) {
+                endpoint = true;
+            } else {
+                CleanUp();
+                state_ = RECOGNIZER_RUNNING;
+                endpoint = !cache_words_.empty();
+            }
+            if (endpoint)
+                Metrics::Get().AddEndpoint();
+        } else {
+            Vector<BaseFloat> wblock(block, kUndefined);
+            memcpy(wblock.Data(), data, block * sizeof(BaseFloat));
+            endpoint = DecodeWaveform(wblock);
+            if (audible)
+                cache->Add(stream_id_, sample_frequency_, start, fingerprinter_->HopDuration(), fingerprint);
+        }
+    }
+
+    cache_buffer_.erase(cache_buffer_.begin(), cache_buffer_.begin() + pos);
+    return endpoint;
+}
+
+bool KaldiRecognizer::DecodeWaveform(Vector<BaseFloat> &wdata)
+{
+    TraceSpan span("AcceptWaveform", stream_id_);
+    Timer timer;
+
     // Cleanup if we finalized previous utterance or the whole feature pipeline
     if (!(state_ == RECOGNIZER_RUNNING || state_ == RECOGNIZER_INITIALIZED)) {
         CleanUp();
@@ -279,29 +403,172 @@ bool KaldiRecognizer::AcceptWaveform(Vector<BaseFloat> &wdata)
     state_ = RECOGNIZER_RUNNING;
 
     // Compute acoustic and ivector features
-    feature_pipeline_->AcceptWaveform(sample_frequency_, wdata);
+    {
+        TraceSpan span("Frontend", stream_id_);
+        feature_pipeline_->AcceptWaveform(sample_frequency_, wdata);
+    }
 
     if (online_) {
         // Update ivector features using computed delta weights if silence weighting is activated
-        UpdateSilenceWeights();
+        {
+            TraceSpan span("UpdateSilenceWeights", stream_id_);
+            UpdateSilenceWeights();
+        }
         // Perform decoding
-        decoder_->AdvanceDecoding();
+        {
+            TraceSpan span("AdvanceDecoding", stream_id_);
+            decoder_->AdvanceDecoding();
+        }
     }
     
+#ifndef VOSK_DISABLE_SPEAKER
     if (spk_feature_) {
+        TraceSpan span("SpkFrontend", stream_id_);
         spk_feature_->AcceptWaveform(sample_frequency_, wdata);
     }
+#endif
 
-    if (decoder_->EndpointDetected(model_->endpoint_config_)) {
-        silence_pos.append(feature_pipeline_->NumFramesReady());
-        return true;
+    bool endpoint;
+    {
+        TraceSpan span("EndpointDetected", stream_id_);
+        endpoint = decoder_->EndpointDetected(model_->endpoint_config_);
+        if (!endpoint && online_ && g_fst_ && model_->grammar_endpoint_config_.enabled)
+            endpoint = GrammarEndpointDetected();
+        if (!endpoint && online_ && model_->stable_endpoint_config_.enabled)
+            endpoint = StableEndpointDetected();
     }
 
+    Metrics::Get().AddAudio(wdata.Dim(), sample_frequency_);
+    utt_samples_ += wdata.Dim();
+    utt_decode_time_ += timer.Elapsed();
     samples_processed_ += wdata.Dim();
 
+    if (endpoint) {
+        Metrics::Get().AddEndpoint();
+        silence_pos.append(feature_pipeline_->NumFramesReady());
+        return true;
+    }
+
     return false;
 }
 
+bool KaldiRecognizer::StableEndpointDetected()
+{
+    const StableEndpointConfig &config = model_->stable_endpoint_config_;
+    int32 num_frames = decoder_->NumFramesDecoded();
+    if (num_frames == 0)
+        return false;
+
+    BaseFloat frame_shift = model_->feature_info_->FrameShiftInSeconds() *
+                            model_->decodable_opts_.frame_subsampling_factor;
+    if (stable_checked_ > 0 && (num_frames - stable_checked_) * frame_shift < config.check_interval)
+        return false;
+    stable_checked_ = num_frames;
+
+    // Trace the backpointers of the best token instead of building the
+    // best path lattice, the words come out last first
+    vector<int32> words;
+    {
+        const LatticeFasterOnlineDecoder &dec = decoder_->Decoder();
+        LatticeArc arc;
+        for (LatticeFasterOnlineDecoder::BestPathIterator iter = dec.BestPathEnd(false); !iter.Done(); ) {
+            iter = dec.TraceBackBestPath(iter, &arc);
+            if (arc.olabel != 0)
+                words.push_back(arc.olabel);
+        }
+    }
+    if (words != stable_words_) {
+        stable_words_.swap(words);
+        stable_since_ = num_frames;
+        return false;
+    }
+    if (stable_words_.empty())
+        return false;
+
+    if ((num_frames - stable_since_) * frame_shift < config.stable_duration)
+        return false;
+
+    if (decoder_->Decoder().FinalRelativeCost() > config.max_final_relative_cost)
+        return false;
+
+    const string &silence_phones = model_->endpoint_config_.silence_phones;
+    if (!silence_phones.empty() &&
+        TrailingSilenceLength(*model_->trans_model_, silence_phones, decoder_->Decoder()) * frame_shift < config.min_trailing_silence)
+        return false;
+
+    return true;
+}
+
+// Tokens of the decoder, which keeps them protected. A derived class can
+// still take member pointers to them and apply them to the decoder.
+class DecoderTokens : public LatticeFasterOnlineDecoder {
+
+public:
+    typedef decoder::BackpointerToken Token;
+    typedef decoder::ForwardLink<Token> Link;
+
+    // Costs of the best final and the best non-final token of the last
+    // decoded frame
+    static void FinalCosts(const LatticeFasterOnlineDecoder &dec, BaseFloat *best_final, BaseFloat *best_non_final)
+    {
+        unordered_map<Token *, BaseFloat> final_costs;
+        BaseFloat final_relative_cost, final_best_cost;
+        (dec.*(&DecoderTokens::ComputeFinalCosts))(&final_costs, &final_relative_cost, &final_best_cost);
+
+        *best_final = *best_non_final = std::numeric_limits<BaseFloat>::infinity();
+        for (Token *tok = (dec.*(&DecoderTokens::active_toks_)).back().toks; tok != NULL; tok = tok->next) {
+            auto it = final_costs.find(tok);
+            if (it == final_costs.end())
+                *best_non_final = std::min(*best_non_final, tok->tot_cost);
+            else
+                *best_final = std::min(*best_final, tok->tot_cost + it->second);
+        }
+    }
+
+    // Tokens and links kept for the utterance, counted in place
+    static void Count(const LatticeFasterOnlineDecoder &dec, int64 *num_tokens, int64 *num_links)
+    {
+        *num_tokens = *num_links = 0;
+        for (const auto &frame : dec.*(&DecoderTokens::active_toks_)) {
+            for (Token *tok = frame.toks; tok != NULL; tok = tok->next) {
+                (*num_tokens)++;
+                for (Link *link = tok->links; link != NULL; link = link->next)
+                    (*num_links)++;
+            }
+        }
+    }
+};
+
+// The grammar is a word loop, so the path is final right after any word
+// and stays final while the silence that follows is decoded. Tokens that
+// start another word or are still inside the word are not final, once the
+// best final token beats all of them by the margin for long enough the
+// command is over.
+bool KaldiRecognizer::GrammarEndpointDetected()
+{
+    const GrammarEndpointConfig &config = model_->grammar_endpoint_config_;
+    int32 num_frames = decoder_->NumFramesDecoded();
+
+    bool leads = num_frames > 0 && decoder_->Decoder().ReachedFinal();
+    if (leads) {
+        BaseFloat best_final, best_non_final;
+        DecoderTokens::FinalCosts(decoder_->Decoder(), &best_final, &best_non_final);
+        leads = best_non_final - best_final >= config.min_final_lead;
+    }
+    if (!leads) {
+        grammar_final_since_ = -1;
+        return false;
+    }
+
+    if (grammar_final_since_ < 0)
+        grammar_final_since_ = num_frames;
+
+    BaseFloat frame_shift = model_->feature_info_->FrameShiftInSeconds() *
+                            model_->decodable_opts_.frame_subsampling_factor;
+    return (num_frames - grammar_final_since_) * frame_shift >= config.min_final_duration;
+}
+
+#ifndef VOSK_DISABLE_SPEAKER
 // Computes an xvector from a chunk of speech features.
 static void RunNnetComputation(const MatrixBase<BaseFloat> &features,
     const nnet3::Nnet &nnet, nnet3::CachingOptimizingCompiler *compiler,
@@ -376,6 +643,7 @@ bool KaldiRecognizer::GetSpkVector(Vector<BaseFloat> &xvector)
     RunNnetComputation(features, spk_model_->speaker_nnet, &compiler, &xvector);
     return true;
 }
+#endif
 
 void KaldiRecognizer::ComputeTimestamp(kaldi::CompactLattice clat)
 {
@@ -386,30 +654,48 @@ void KaldiRecognizer::ComputeTimestamp(kaldi::CompactLattice clat)
         //fst::ScaleLattice(fst::GraphLatticeScale(0.9), &clat); // Apply rescoring weight
         CompactLattice aligned_lat;
         if (model_->winfo_) {
+            TraceSpan span("WordAlign", stream_id_);
             WordAlignLattice(clat, *model_->trans_model_, *model_->winfo_, 0, &aligned_lat);
         } else {
             aligned_lat = clat;
         }
 
-        MinimumBayesRisk mbr(aligned_lat);
-        const vector<BaseFloat> &conf = mbr.GetOneBestConfidences();
-        const vector<int32> &words = mbr.GetOneBest();
-        const vector<pair<BaseFloat, BaseFloat> > &times =
-            mbr.GetOneBestTimes();
+        vector<BaseFloat> conf;
+        vector<int32> words;
+        vector<pair<BaseFloat, BaseFloat> > times;
+        {
+            TraceSpan span("MBR", stream_id_);
+            MinimumBayesRisk mbr(aligned_lat);
+            conf = mbr.GetOneBestConfidences();
+            words = mbr.GetOneBest();
+            times = mbr.GetOneBestTimes();
+            if (index_writer_)
+                AddToIndex(mbr);
+        }
+
+        TraceSpan span("JSON", stream_id_);
 
         int size = words.size();
 
         stringstream text;
+        vector<FingerprintWord> cache_words;
 
         // Create JSON object
         for (int i = 0; i < size; i++) {
             json::JSON word;
             string w = model_->word_syms_->Find(words[i]);
             word["word"] = w;
-            word["start"] = samples_round_start_ / sample_frequency_ + (frame_offset_ + times[i].first) * 0.03;
-            word["end"] = samples_round_start_ / sample_frequency_ + (frame_offset_ + times[i].second) * 0.03;
+            double start = samples_round_start_ / sample_frequency_ + (frame_offset_ + times[i].first) * 0.03;
+            double end = samples_round_start_ / sample_frequency_ + (frame_offset_ + times[i].second) * 0.03;
+            word["start"] = start;
+            word["end"] = end;
             word["conf"] = conf[i];
 
+            if (fingerprinter_) {
+                FingerprintWord cache_word = { w, start, end, conf[i] };
+                cache_words.push_back(cache_word);
+            }
+
             if (w.compare("<unk>") != 0)
                 uttConfidence += conf[i];
             
@@ -421,6 +707,9 @@ void KaldiRecognizer::ComputeTimestamp(kaldi::CompactLattice clat)
             text << model_->word_syms_->Find(words[i]);
         }
         uttConfidence /= size;
+
+        if (fingerprinter_)
+            model_->fingerprint_cache_->AddWords(stream_id_, cache_words);
         
         if (metadata_["text"].ToString() == ""){
             metadata_["text"] = text.str();
@@ -438,53 +727,106 @@ void KaldiRecognizer::ComputeTimestamp(kaldi::CompactLattice clat)
 
 }
 
+// Every word of the confusion network bins goes to the index, so words
+// the best path missed can still be found
+void KaldiRecognizer::AddToIndex(const MinimumBayesRisk &mbr)
+{
+    TraceSpan span("Index", stream_id_);
+
+    const vector<vector<pair<int32, BaseFloat> > > &sausage = mbr.GetSausageStats();
+    const vector<pair<BaseFloat, BaseFloat> > &times = mbr.GetSausageTimes();
+    double offset = samples_round_start_ / sample_frequency_;
+
+    vector<IndexHit> hits;
+    for (size_t i = 0; i < sausage.size(); i++) {
+        for (size_t j = 0; j < sausage[i].size(); j++) {
+            if (sausage[i][j].first == 0)
+                continue;
+            IndexHit hit;
+            hit.word = model_->word_syms_->Find(sausage[i][j].first);
+            if (hit.word == "<unk>" || hit.word == "[unk]")
+                continue;
+            hit.start = offset + (frame_offset_ + times[i].first) * 0.03;
+            hit.end = offset + (frame_offset_ + times[i].second) * 0.03;
+            hit.posterior = sausage[i][j].second;
+            hits.push_back(hit);
+        }
+    }
+    index_writer_->Add(index_doc_, hits);
+}
+
+void KaldiRecognizer::SetIndex(SearchIndexWriter *writer, const char *doc)
+{
+    index_writer_ = writer;
+    index_doc_ = doc ? doc : "";
+}
+
 const char* KaldiRecognizer::GetResult()
 {
+    TraceSpan span("GetResult", stream_id_);
+
     if (decoder_->NumFramesDecoded() == 0) {
-        return StoreReturn("{\"text\": \"\"}");
+        return StoreResult("");
     }
 
     kaldi::CompactLattice clat;
-    decoder_->GetLattice(true, &clat);
+    {
+        TraceSpan span("GetLattice", stream_id_);
+        decoder_->GetLattice(true, &clat);
+    }
 
+#ifndef VOSK_DISABLE_RESCORE
     if (model_->std_lm_fst_) {
+        Timer rescoring_timer;
         Lattice lat1;
-
-        ConvertLattice(clat, &lat1);
-        fst::ScaleLattice(fst::GraphLatticeScale(-1.0), &lat1);
-        fst::ArcSort(&lat1, fst::OLabelCompare<kaldi::LatticeArc>());
         kaldi::Lattice composed_lat;
-        fst::Compose(lat1, *lm_fst_, &composed_lat);
-        fst::Invert(&composed_lat);
+        {
+            TraceSpan span("Compose", stream_id_);
+            ConvertLattice(clat, &lat1);
+            fst::ScaleLattice(fst::GraphLatticeScale(-1.0), &lat1);
+            fst::ArcSort(&lat1, fst::OLabelCompare<kaldi::LatticeArc>());
+            fst::Compose(lat1, *lm_fst_, &composed_lat);
+            fst::Invert(&composed_lat);
+        }
         kaldi::CompactLattice determinized_lat;
-        DeterminizeLattice(composed_lat, &determinized_lat);
-        fst::ScaleLattice(fst::GraphLatticeScale(-1), &determinized_lat);
-        fst::ArcSort(&determinized_lat, fst::OLabelCompare<kaldi::CompactLatticeArc>());
+        {
+            TraceSpan span("Determinize", stream_id_);
+            DeterminizeLattice(composed_lat, &determinized_lat);
+            fst::ScaleLattice(fst::GraphLatticeScale(-1), &determinized_lat);
+            fst::ArcSort(&determinized_lat, fst::OLabelCompare<kaldi::CompactLatticeArc>());
+        }
 
-        kaldi::ConstArpaLmDeterministicFst const_arpa_fst(model_->const_arpa_);
-        kaldi::CompactLattice composed_clat;
-        kaldi::ComposeCompactLatticeDeterministic(determinized_lat, &const_arpa_fst, &composed_clat);
-        kaldi::Lattice composed_lat1;
-        ConvertLattice(composed_clat, &composed_lat1);
-        fst::Invert(&composed_lat1);
-        DeterminizeLattice(composed_lat1, &clat);
+        {
+            TraceSpan span("CARPA", stream_id_);
+            kaldi::ConstArpaLmDeterministicFst const_arpa_fst(model_->const_arpa_);
+            kaldi::CompactLattice composed_clat;
+            kaldi::ComposeCompactLatticeDeterministic(determinized_lat, &const_arpa_fst, &composed_clat);
+            kaldi::Lattice composed_lat1;
+            ConvertLattice(composed_clat, &composed_lat1);
+            fst::Invert(&composed_lat1);
+            DeterminizeLattice(composed_lat1, &clat);
+        }
+        Metrics::Get().ObserveRescoring(rescoring_timer.Elapsed());
     }
+#endif
 
     if (clat.NumStates() == 0) {
         KALDI_WARN << "Empty lattice.";
-        return StoreReturn("{\"text\": \"\"}");
+        return StoreResult("");
     }
 
-    kaldi::CompactLattice best_path_clat;
-    kaldi::CompactLatticeShortestPath(clat, &best_path_clat);
-   
-    kaldi::Lattice best_path_lat;
-    ConvertLattice(best_path_clat, &best_path_lat);
-
     kaldi::LatticeWeight weight;
     std::vector<int32> alignment;
     std::vector<int32> words;
-    fst::GetLinearSymbolSequence(best_path_lat, &alignment, &words, &weight);
+    {
+        TraceSpan span("BestPath", stream_id_);
+        kaldi::CompactLattice best_path_clat;
+        kaldi::CompactLatticeShortestPath(clat, &best_path_clat);
+
+        kaldi::Lattice best_path_lat;
+        ConvertLattice(best_path_clat, &best_path_lat);
+        fst::GetLinearSymbolSequence(best_path_lat, &alignment, &words, &weight);
+    }
 
     int size = words.size();
 
@@ -499,11 +841,62 @@ const char* KaldiRecognizer::GetResult()
 
     ComputeTimestamp(clat);
 
-    return StoreReturn("{\"text\": \""+text.str()+"\"}");
+    return StoreResult(text.str());
+}
+
+// Stores the result, words reused from the fingerprint cache for skipped
+// audio follow the decoded ones
+const char *KaldiRecognizer::StoreResult(const string &text)
+{
+    if (cache_words_.empty()) {
+        return StoreReturn("{\"text\": \""+text+"\"}");
+    }
+
+    stringstream cached_text;
+    vector<IndexHit> hits;
+    for (size_t i = 0; i < cache_words_.size(); i++) {
+        if (i) {
+            cached_text << " ";
+        }
+        cached_text << cache_words_[i].word;
+
+        if (index_writer_) {
+            IndexHit hit = { cache_words_[i].word, cache_words_[i].start,
+                             cache_words_[i].end, cache_words_[i].conf };
+            hits.push_back(hit);
+        }
+
+        if (!metadata_.IsNull()) {
+            json::JSON word;
+            word["word"] = cache_words_[i].word;
+            word["start"] = cache_words_[i].start;
+            word["end"] = cache_words_[i].end;
+            word["conf"] = cache_words_[i].conf;
+            word["cached"] = true;
+            metadata_["words"].append(word);
+        }
+    }
+    cache_words_.clear();
+
+    if (index_writer_)
+        index_writer_->Add(index_doc_, hits);
+
+    if (!metadata_.IsNull()) {
+        if (metadata_["text"].ToString() == "") {
+            metadata_["text"] = cached_text.str();
+        } else {
+            metadata_["text"] = metadata_["text"].ToString() + " " + cached_text.str();
+        }
+    }
+
+    string full_text = text.empty() ? cached_text.str() : text + " " + cached_text.str();
+    return StoreReturn("{\"text\": \""+full_text+"\"}");
 }
 
 const char* KaldiRecognizer::PartialResult()
 {
+    TraceSpan span("PartialResult", stream_id_);
+
     if (state_ != RECOGNIZER_RUNNING) {
         return StoreReturn("{\"partial\": \"\"}");
     }
@@ -534,27 +927,56 @@ const char* KaldiRecognizer::Result()
     if (state_ != RECOGNIZER_RUNNING) {
         return StoreReturn("{\"text\": \"\"}");
     }
+
+    TraceSpan span("Result", stream_id_);
+    Timer timer;
+
     decoder_->FinalizeDecoding();
     state_ = RECOGNIZER_ENDPOINT;
-    return GetResult();
+    GetResult();
+    UpdateUtteranceMetrics(timer.Elapsed());
+
+    return last_result_.c_str();
 }
 
 const char* KaldiRecognizer::FinalResult()
 {
+    // The last incomplete block of the fingerprint cache is decoded as is
+    if (!cache_buffer_.empty()) {
+        Vector<BaseFloat> wdata(cache_buffer_.size(), kUndefined);
+        memcpy(wdata.Data(), cache_buffer_.data(), cache_buffer_.size() * sizeof(BaseFloat));
+        cache_buffer_.clear();
+        DecodeWaveform(wdata);
+    }
+
     if (state_ != RECOGNIZER_RUNNING) {
         return StoreReturn("{\"text\": \"\"}");
     }
 
+    TraceSpan span("FinalResult", stream_id_);
+    Timer timer;
+
     feature_pipeline_->InputFinished();
     UpdateSilenceWeights();
     decoder_->AdvanceDecoding();
     decoder_->FinalizeDecoding();
     state_ = RECOGNIZER_FINALIZED;
     GetResult();
+    UpdateUtteranceMetrics(timer.Elapsed());
 
     return last_result_.c_str();
 }
 
+void KaldiRecognizer::UpdateUtteranceMetrics(double finalization_time)
+{
+    Metrics::Get().ObserveFinalization(finalization_time);
+    if (utt_samples_ > 0) {
+        Metrics::Get().ObserveRtf((utt_decode_time_ + finalization_time) * sample_frequency_ / utt_samples_);
+    }
+    utt_samples_ = 0;
+    utt_decode_time_ = 0;
+}
+
 const char* KaldiRecognizer::GetMetadata()
 {
     if (metadata_.IsNull()) {
@@ -564,6 +986,35 @@ const char* KaldiRecognizer::GetMetadata()
     return last_result_.c_str();
 }
 
+// Memory owned by the recognizer. Feature buffers and the decoder state
+// grow with the utterance, the compose caches of the lookahead graph and
+// rescoring LM are bounded by their garbage collection limit which is
+// reported instead since OpenFst doesn't expose the actual cache size.
+const char* KaldiRecognizer::GetMemoryUsage()
+{
+    json::JSON usage;
+
+    int64 feature_frames = feature_pipeline_->NumFramesReady();
+    usage["feature_frames"] = feature_frames;
+    usage["feature_pipeline"] = feature_frames * feature_pipeline_->Dim() * (int64)sizeof(BaseFloat);
+
+    int64 num_tokens, num_links;
+    DecoderTokens::Count(decoder_->Decoder(), &num_tokens, &num_links);
+    usage["decoder_tokens"] = num_tokens;
+    usage["decoder"] = num_tokens * (int64)sizeof(DecoderTokens::Token) +
+                       num_links * (int64)sizeof(DecoderTokens::Link);
+
+    usage["grammar_fst"] = g_fst_ ? FstMemoryUsage(*g_fst_) : 0;
+    usage["decode_fst_cache_limit"] = decode_fst_ ? (int64)fst::CacheOptions().gc_limit : 0;
+    usage["lm_fst_cache_limit"] = lm_fst_ ? LM_FST_CACHE_SIZE : 0;
+    usage["fingerprint_buffer"] = (int64)(cache_buffer_.capacity() * sizeof(BaseFloat));
+
+    usage["metadata"] = metadata_.IsNull() ? 0 : (int64)metadata_.dump().size();
+    usage["spk_feature"] = spk_feature_ ? spk_feature_->NumFramesReady() * spk_feature_->Dim() * (int64)sizeof(BaseFloat) : 0;
+
+    return StoreReturn(usage.dump());
+}
+
 // Store result in recognizer and return as const string
 const char *KaldiRecognizer::StoreReturn(const string &res)
 {
@@ -28,6 +28,10 @@
 
 #include "model.h"
 #include "spk_model.h"
+#include "trace.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "search_index.h"
 
 using namespace kaldi;
 
@@ -50,7 +54,12 @@ class KaldiRecognizer {
         const char* FinalResult();
         const char* PartialResult();
         const char* GetMetadata();
+        float SampleFrequency() const { return sample_frequency_; };
+        const char* GetMemoryUsage();
+        // Adds the words of the following results to the index under the document name
+        void SetIndex(SearchIndexWriter *writer, const char *doc);
         float uttConfidence;
+        Recorder *recorder; // traffic recorder, NULL unless recording was active on creation
 
     private:
         void InitState();
@@ -58,10 +67,19 @@ class KaldiRecognizer {
         void CleanUp();
         void UpdateSilenceWeights();
         bool AcceptWaveform(Vector<BaseFloat> &wdata);
+        bool AcceptCached(Vector<BaseFloat> &wdata);
+        bool DecodeWaveform(Vector<BaseFloat> &wdata);
+        bool StableEndpointDetected();
+        bool GrammarEndpointDetected();
+#ifndef VOSK_DISABLE_SPEAKER
         bool GetSpkVector(Vector<BaseFloat> &xvector);
+#endif
         const char *GetResult();
         const char *StoreReturn(const string &res);
+        const char *StoreResult(const string &text);
         void ComputeTimestamp(kaldi::CompactLattice clat);
+        void AddToIndex(const MinimumBayesRisk &mbr);
+        void UpdateUtteranceMetrics(double finalization_time);
         void getFeatureFrames();
 
         Model *model_;
@@ -78,10 +96,33 @@ class KaldiRecognizer {
 
         float sample_frequency_;
         int32 frame_offset_;
+        int stream_id_; // identifies the recognizer in traces
 
         int64 samples_processed_;
         int64 samples_round_start_;
 
+        // Words of the best path, last word first, the frame they last
+        // changed on and the frame they were last checked on
+        vector<int32> stable_words_;
+        int32 stable_since_;
+        int32 stable_checked_;
+        int32 grammar_final_since_; // first frame the best path was final, -1 if not final
+
+        // Fingerprint cache state, audio waits in the buffer for a complete
+        // block, skipped samples move the timeline on the next restart and
+        // the words known for skipped blocks go to the next result
+        Fingerprinter *fingerprinter_;
+        vector<BaseFloat> cache_buffer_;
+        int64 cache_skipped_samples_;
+        vector<FingerprintWord> cache_words_;
+
+        SearchIndexWriter *index_writer_; // NULL unless indexing
+        string index_doc_;
+
+        // Utterance processing statistics for the real-time factor metric
+        int64 utt_samples_;
+        double utt_decode_time_;
+
         KaldiRecognizerState state_;
         string last_result_;
         /** Metadata:
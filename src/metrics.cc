@@ -0,0 +1,127 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "metrics.h"
+
+#include <iomanip>
+#include <sstream>
+
+// Counters are printed exactly, the default precision of 6 digits would
+// freeze a large counter between scrapes
+static void RenderValue(std::string &out, const char *name, const char *help, const char *type, double value)
+{
+    std::ostringstream ss;
+    ss << "# HELP " << name << " " << help << "\n";
+    ss << "# TYPE " << name << " " << type << "\n";
+    ss << name << " " << std::setprecision(17) << value << "\n";
+    out += ss.str();
+}
+
+static void RenderValue(std::string &out, const char *name, const char *help, const char *type, int64_t value)
+{
+    std::ostringstream ss;
+    ss << "# HELP " << name << " " << help << "\n";
+    ss << "# TYPE " << name << " " << type << "\n";
+    ss << name << " " << value << "\n";
+    out += ss.str();
+}
+
+void MetricsHistogram::Observe(double value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t i = 0;
+    while (i < bounds_.size() && value > bounds_[i])
+        i++;
+    counts_[i]++;
+    sum_ += value;
+    count_++;
+}
+
+void MetricsHistogram::Render(std::string &out, const char *name, const char *help)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::ostringstream ss;
+    ss << "# HELP " << name << " " << help << "\n";
+    ss << "# TYPE " << name << " histogram\n";
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < bounds_.size(); i++) {
+        cumulative += counts_[i];
+        ss << name << "_bucket{le=\"" << bounds_[i] << "\"} " << cumulative << "\n";
+    }
+    ss << name << "_bucket{le=\"+Inf\"} " << count_ << "\n";
+    ss << name << "_sum " << std::setprecision(17) << sum_ << "\n";
+    ss << name << "_count " << count_ << "\n";
+    out += ss.str();
+}
+
+Metrics::Metrics() :
+    active_recognizers_(0), loaded_models_(0), model_bytes_(0), endpoints_(0),
+    fingerprint_lookups_(0), fingerprint_hits_(0), audio_us_(0),
+    rtf_({0.05, 0.1, 0.2, 0.3, 0.5, 0.75, 1.0, 1.5, 2.0}),
+    finalization_({0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5}),
+    rescoring_({0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5})
+{
+}
+
+Metrics &Metrics::Get()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::ModelLoaded(int64_t bytes)
+{
+    loaded_models_++;
+    model_bytes_ += bytes;
+}
+
+void Metrics::ModelReleased(int64_t bytes)
+{
+    loaded_models_--;
+    model_bytes_ -= bytes;
+}
+
+void Metrics::AddAudio(int64_t samples, float sample_frequency)
+{
+    audio_us_ += (int64_t)(samples * 1000000.0 / sample_frequency + 0.5);
+}
+
+std::string Metrics::Render()
+{
+    std::string out;
+
+    RenderValue(out, "vosk_active_recognizers", "Number of recognizers currently allocated.",
+                "gauge", active_recognizers_.load());
+    RenderValue(out, "vosk_loaded_models", "Number of models currently loaded.",
+                "gauge", loaded_models_.load());
+    RenderValue(out, "vosk_model_bytes", "Estimated memory of the loaded models.",
+                "gauge", model_bytes_.load());
+    RenderValue(out, "vosk_audio_seconds_total", "Seconds of audio accepted by recognizers.",
+                "counter", audio_us_.load() / 1000000.0);
+    RenderValue(out, "vosk_endpoints_total", "Number of detected utterance endpoints.",
+                "counter", endpoints_.load());
+    RenderValue(out, "vosk_fingerprint_lookups_total", "Number of audio blocks looked up in the fingerprint cache.",
+                "counter", fingerprint_lookups_.load());
+    RenderValue(out, "vosk_fingerprint_hits_total", "Number of audio blocks skipped on a fingerprint cache hit.",
+                "counter", fingerprint_hits_.load());
+
+    rtf_.Render(out, "vosk_utterance_rtf", "Real-time factor of decoded utterances.");
+    finalization_.Render(out, "vosk_finalization_seconds", "Latency of Result and FinalResult calls.");
+    rescoring_.Render(out, "vosk_rescoring_seconds", "Time spent in lattice rescoring per result.");
+
+    return out;
+}
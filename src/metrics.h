@@ -0,0 +1,79 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Cumulative histogram with fixed bucket upper bounds
+class MetricsHistogram {
+
+public:
+    MetricsHistogram(const std::vector<double> &bounds) : bounds_(bounds), counts_(bounds.size() + 1, 0), sum_(0), count_(0) {};
+    void Observe(double value);
+    void Render(std::string &out, const char *name, const char *help);
+
+private:
+    std::mutex mutex_;
+    std::vector<double> bounds_;
+    std::vector<uint64_t> counts_;
+    double sum_;
+    uint64_t count_;
+};
+
+// Process-wide decoder metrics rendered in Prometheus text exposition format
+class Metrics {
+
+public:
+    static Metrics &Get();
+
+    void ModelLoaded(int64_t bytes);
+    void ModelReleased(int64_t bytes);
+    void RecognizerCreated() { active_recognizers_++; }
+    void RecognizerReleased() { active_recognizers_--; }
+
+    void AddAudio(int64_t samples, float sample_frequency);
+    void AddEndpoint() { endpoints_++; }
+    void ObserveRtf(double rtf) { rtf_.Observe(rtf); }
+    void ObserveFinalization(double seconds) { finalization_.Observe(seconds); }
+    void ObserveRescoring(double seconds) { rescoring_.Observe(seconds); }
+    void AddFingerprintLookup(bool hit) { fingerprint_lookups_++; if (hit) fingerprint_hits_++; }
+
+    std::string Render();
+
+private:
+    Metrics();
+
+    std::atomic<int64_t> active_recognizers_;
+    std::atomic<int64_t> loaded_models_;
+    std::atomic<int64_t> model_bytes_;
+    std::atomic<int64_t> endpoints_;
+    std::atomic<int64_t> fingerprint_lookups_;
+    std::atomic<int64_t> fingerprint_hits_;
+
+    // Microseconds, so accepting audio needs no lock
+    std::atomic<int64_t> audio_us_;
+
+    MetricsHistogram rtf_;
+    MetricsHistogram finalization_;
+    MetricsHistogram rescoring_;
+};
+
+#endif /* METRICS_H_ */
@@ -25,10 +25,15 @@
 
 
 #include "model.h"
+#include "metrics.h"
+#include "json.h"
 
 #include <sys/stat.h>
+#include <string.h>
 #include <fst/fst.h>
 #include <fst/register.h>
+
+#ifndef VOSK_DISABLE_LOOKAHEAD
 #include <fst/matcher-fst.h>
 #include <fst/extensions/ngram/ngram-fst.h>
 
@@ -38,6 +43,7 @@ static FstRegisterer<StdOLabelLookAheadFst> OLabelLookAheadFst_StdArc_registerer
 static FstRegisterer<NGramFst<StdArc>> NGramFst_StdArc_registerer;
 
 }  // namespace fst
+#endif
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -111,26 +117,288 @@ static void KaldiLogHandler(const LogMessageEnvelope &env, const char *message)
 }
 #endif
 
-Model::Model(const char *acmodel_path, const char *langmodel_path, const char *config_file_path) : acmodel_path_str_(acmodel_path), langmodel_path_str_(langmodel_path), config_file_path_str_(config_file_path) {
+// Trailing path components shared by two paths
+static int CommonSuffix(const string &a, const string &b)
+{
+    int common = 0;
+    size_t i = a.size(), j = b.size();
+    while (i > 0 && j > 0) {
+        size_t ai = a.rfind('/', i - 1), bj = b.rfind('/', j - 1);
+        size_t as = ai == string::npos ? 0 : ai + 1, bs = bj == string::npos ? 0 : bj + 1;
+        if (a.compare(as, i - as, b, bs, j - bs) != 0)
+            break;
+        common++;
+        if (ai == string::npos || bj == string::npos)
+            break;
+        i = ai;
+        j = bj;
+    }
+    return common;
+}
+
+void ModelFiles::Add(const string &name, const char *data, size_t size)
+{
+    File file = { name.compare(0, 2, "./") == 0 ? name.substr(2) : name, data, size };
+    if (files_.empty())
+        root_ = file.name.substr(0, file.name.find('/') + 1);
+    else if (file.name.compare(0, root_.size(), root_) != 0)
+        root_.clear();
+    files_.push_back(file);
+}
+
+static size_t TarNumber(const char *field, int len)
+{
+    size_t value = 0;
+    if ((unsigned char)field[0] & 0x80) {
+        // Base-256 encoding of large sizes
+        for (int i = 1; i < len; i++)
+            value = (value << 8) | (unsigned char)field[i];
+        return value;
+    }
+    for (int i = 0; i < len && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7')
+            value = value * 8 + field[i] - '0';
+    }
+    return value;
+}
+
+bool ModelFiles::AddTar(const char *data, size_t size)
+{
+    string long_name;
+    size_t pos = 0;
+
+    while (pos + 512 <= size && data[pos] != 0) {
+        const char *header = data + pos;
+        size_t file_size = TarNumber(header + 124, 12);
+        char type = header[156];
+        pos += 512;
+        if (file_size > size - pos)
+            return false;
+
+        if (type == 'L') {
+            // GNU long name of the next entry
+            long_name.assign(data + pos, strnlen(data + pos, file_size));
+        } else if (type == '0' || type == 0) {
+            string name;
+            if (!long_name.empty()) {
+                name = long_name;
+            } else {
+                name.assign(header, strnlen(header, 100));
+                if (memcmp(header + 257, "ustar", 5) == 0 && header[345])
+                    name = string(header + 345, strnlen(header + 345, 155)) + "/" + name;
+            }
+            Add(name, data + pos, file_size);
+            long_name.clear();
+        }
+        pos += (file_size + 511) / 512 * 512;
+    }
+    return true;
+}
+
+bool ModelFiles::Find(const string &path, const char **data, size_t *size) const
+{
+    for (const File &file : files_) {
+        if (file.name == path || (file.name.size() == root_.size() + path.size() &&
+                                  file.name.compare(0, root_.size(), root_) == 0 &&
+                                  file.name.compare(root_.size(), path.size(), path) == 0)) {
+            *data = file.data;
+            *size = file.size;
+            return true;
+        }
+    }
+    return false;
+}
+
+string ModelFiles::MatchSuffix(const string &path) const
+{
+    const File *best = NULL;
+    int best_common = 0;
+    for (const File &file : files_) {
+        int common = CommonSuffix(path, file.name);
+        if (common > best_common) {
+            best = &file;
+            best_common = common;
+        }
+    }
+    return best ? best->name : path;
+}
 
+// Seekable stream buffer over memory, OpenFst readers query positions
+class MemoryStreamBuf : public std::streambuf {
+
+public:
+    void Reset(const char *data, size_t size) {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+        char *pos = dir == std::ios_base::beg ? eback() + off :
+                    dir == std::ios_base::cur ? gptr() + off : egptr() + off;
+        if (!(which & std::ios_base::in) || pos < eback() || pos > egptr())
+            return pos_type(off_type(-1));
+        setg(eback(), pos, egptr());
+        return pos_type(pos - eback());
+    }
+
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+// Model file read from the filesystem or from memory, the binary flag
+// is detected the same way as by kaldi::Input when requested
+class ModelInput {
+
+public:
+    ModelInput(const ModelFiles *files, const string &path, bool *binary = NULL) :
+        stream_(&buf_), memory_(files != NULL) {
+        if (!memory_) {
+            input_.Open(path, binary);
+            return;
+        }
+        const char *data;
+        size_t size;
+        if (!files->Find(path, &data, &size))
+            KALDI_ERR << "Model file " << path << " is missing";
+        buf_.Reset(data, size);
+        if (binary)
+            InitKaldiInputStream(stream_, binary);
+    }
+
+    std::istream &Stream() {
+        return memory_ ? stream_ : input_.Stream();
+    }
+
+private:
+    kaldi::Input input_;
+    MemoryStreamBuf buf_;
+    std::istream stream_;
+    bool memory_;
+};
+
+Model::Model(const char *acmodel_path, const char *langmodel_path, const char *config_file_path) : acmodel_path_str_(acmodel_path), langmodel_path_str_(langmodel_path), config_file_path_str_(config_file_path), files_(NULL) {
+
+    Load();
+}
+
+Model::Model(const ModelFiles &files) : acmodel_path_str_("am"), langmodel_path_str_("graph"), config_file_path_str_("am/conf/online.conf"), files_(&files) {
+
+    Load();
+    files_ = NULL;
+}
+
+static int64 FileSize(const ModelFiles *files, const string &path)
+{
+    if (files) {
+        const char *data;
+        size_t size;
+        return files->Find(path, &data, &size) ? size : 0;
+    }
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) == 0)
+        return buffer.st_size;
+    return 0;
+}
+
+void Model::Load()
+{
     SetLogHandler(KaldiLogHandler);
     Configure();
     ReadDataFiles();
 
+    // Model files are not available after loading from memory
+    carpa_bytes_ = std_lm_fst_ ? FileSize(files_, carpa_rxfilename_) : 0;
+    memory_bytes_ = EstimateMemoryUsage();
+
+    fingerprint_cache_ = fingerprint_cache_config_.enabled ?
+        new FingerprintCache(fingerprint_cache_config_) : NULL;
+
+    Metrics::Get().ModelLoaded(memory_bytes_);
     ref_cnt_ = 1;
 }
 
-void Model::Configure()
+// Paths inside the configs are resolved by their trailing part in memory
+string Model::ConfigPath(const string &path)
 {
+    return files_ ? files_->MatchSuffix(path) : path;
+}
+
+bool Model::FileExists(const string &path)
+{
+    if (files_) {
+        const char *data;
+        size_t size;
+        return files_->Find(path, &data, &size);
+    }
     struct stat buffer;
+    return stat(path.c_str(), &buffer) == 0;
+}
+
+string Model::ReadText(const string &path)
+{
+    ModelInput in(files_, path);
+    std::ostringstream text;
+    text << in.Stream().rdbuf();
+    return text.str();
+}
 
+template <class C>
+void Model::ReadObject(const string &path, C *c)
+{
+    bool binary;
+    ModelInput in(files_, path, &binary);
+    c->Read(in.Stream(), binary);
+}
+
+// Parses the config from memory the way ParseOptions::ReadConfigFile
+// parses files: one option per line, '#' starts a comment
+static void ReadConfigText(ParseOptions *po, const string &path, const string &text)
+{
+    vector<string> args;
+    args.push_back("vosk");
+    std::istringstream is(text);
+    string line;
+    while (std::getline(is, line)) {
+        line = line.substr(0, line.find('#'));
+        Trim(&line);
+        if (line.empty())
+            continue;
+        if (line.compare(0, 2, "--") != 0)
+            KALDI_ERR << "Reading config file " << path << ": line is not an option: " << line;
+        args.push_back(line);
+    }
+
+    vector<const char *> argv;
+    for (const string &arg : args)
+        argv.push_back(arg.c_str());
+    po->Read(argv.size(), argv.data());
+}
+
+template <class C>
+void Model::ReadOptions(const string &path, C *opts)
+{
+    ParseOptions po("");
+    opts->Register(&po);
+    ReadConfigText(&po, path, ReadText(path));
+}
+
+void Model::Configure()
+{
     kaldi::ParseOptions po("something");
     nnet3_decoding_config_.Register(&po);
     endpoint_config_.Register(&po);
+    stable_endpoint_config_.Register(&po);
+    grammar_endpoint_config_.Register(&po);
+    fingerprint_cache_config_.Register(&po);
+    aligner_config_.Register(&po);
     decodable_opts_.Register(&po);
     feature_config_.Register(&po);
 
-    if (stat(config_file_path_str_.c_str(), &buffer) == 0){
+    if (files_) {
+      ReadConfigText(&po, config_file_path_str_, ReadText(config_file_path_str_));
+    } else if (FileExists(config_file_path_str_)){
       KALDI_LOG << "Loading decode config file from " << config_file_path_str_;
       po.ReadConfigFile(config_file_path_str_);
     } else {
@@ -144,16 +412,79 @@ void Model::Configure()
     disambig_rxfilename_ = langmodel_path_str_ + "/disambig_tid.int";
     word_syms_rxfilename_ = langmodel_path_str_ + "/words.txt";
     winfo_rxfilename_ = langmodel_path_str_ + "/word_boundary.int";
+    phone_syms_rxfilename_ = langmodel_path_str_ + "/phones.txt";
     carpa_rxfilename_ = langmodel_path_str_ + "/rescore/G.carpa";
     std_fst_rxfilename_ = langmodel_path_str_ + "/rescore/G.fst";
 }
 
-void Model::ReadDataFiles()
+// Same as kaldi::OnlineNnet2FeaturePipelineInfo constructor, but reads
+// the feature and i-vector extractor files through ModelInput
+void Model::ReadFeatureInfo()
 {
-    struct stat buffer;
+    if (!files_) {
+        feature_info_ = new kaldi::OnlineNnet2FeaturePipelineInfo (feature_config_);
+        return;
+    }
 
+    OnlineNnet2FeaturePipelineConfig config = feature_config_;
+    config.mfcc_config = "";
+    config.plp_config = "";
+    config.fbank_config = "";
+    config.add_pitch = false;
+    config.ivector_extraction_config = "";
+    feature_info_ = new kaldi::OnlineNnet2FeaturePipelineInfo (config);
+
+    if (feature_config_.mfcc_config != "")
+        ReadOptions(ConfigPath(feature_config_.mfcc_config), &feature_info_->mfcc_opts);
+    if (feature_config_.plp_config != "")
+        ReadOptions(ConfigPath(feature_config_.plp_config), &feature_info_->plp_opts);
+    if (feature_config_.fbank_config != "")
+        ReadOptions(ConfigPath(feature_config_.fbank_config), &feature_info_->fbank_opts);
+    if (feature_config_.add_pitch) {
+        ParseOptions po("");
+        feature_info_->pitch_opts.Register(&po);
+        feature_info_->pitch_process_opts.Register(&po);
+        string pitch_config = ConfigPath(feature_config_.online_pitch_config);
+        ReadConfigText(&po, pitch_config, ReadText(pitch_config));
+        feature_info_->add_pitch = true;
+    }
+
+    if (feature_config_.ivector_extraction_config != "") {
+        OnlineIvectorExtractionConfig ivector_config;
+        ReadOptions(ConfigPath(feature_config_.ivector_extraction_config), &ivector_config);
+
+        OnlineIvectorExtractionInfo &info = feature_info_->ivector_extractor_info;
+        info.ivector_period = ivector_config.ivector_period;
+        info.num_gselect = ivector_config.num_gselect;
+        info.min_post = ivector_config.min_post;
+        info.posterior_scale = ivector_config.posterior_scale;
+        info.max_count = ivector_config.max_count;
+        info.num_cg_iters = ivector_config.num_cg_iters;
+        info.use_most_recent_ivector = ivector_config.use_most_recent_ivector;
+        info.greedy_ivector_extractor = ivector_config.greedy_ivector_extractor;
+        if (info.greedy_ivector_extractor && !info.use_most_recent_ivector) {
+            KALDI_WARN << "--greedy-ivector-extractor=true implies --use-most-recent-ivector=true";
+            info.use_most_recent_ivector = true;
+        }
+        info.max_remembered_frames = ivector_config.max_remembered_frames;
+        info.online_cmvn_iextractor = ivector_config.online_cmvn_iextractor;
+
+        ReadObject(ConfigPath(ivector_config.lda_mat_rxfilename), &info.lda_mat);
+        ReadObject(ConfigPath(ivector_config.global_cmvn_stats_rxfilename), &info.global_cmvn_stats);
+        ReadOptions(ConfigPath(ivector_config.cmvn_config_rxfilename), &info.cmvn_opts);
+        ReadOptions(ConfigPath(ivector_config.splice_config_rxfilename), &info.splice_opts);
+        ReadObject(ConfigPath(ivector_config.diag_ubm_rxfilename), &info.diag_ubm);
+        ReadObject(ConfigPath(ivector_config.ivector_extractor_rxfilename), &info.extractor);
+        info.Check();
+
+        feature_info_->use_ivectors = true;
+    }
+}
+
+void Model::ReadDataFiles()
+{
     //load feature extraction config and ivector extractiong config
-    feature_info_ = new kaldi::OnlineNnet2FeaturePipelineInfo (feature_config_);
+    ReadFeatureInfo();
 
     //load acoustic model and decode config
     KALDI_LOG << "Am model file "<< nnet3_rxfilename_;
@@ -161,7 +492,7 @@ void Model::ReadDataFiles()
     nnet_ = new kaldi::nnet3::AmNnetSimple();
     {
         bool binary;
-        kaldi::Input ki(nnet3_rxfilename_, &binary);
+        ModelInput ki(files_, nnet3_rxfilename_, &binary);
         trans_model_->Read(ki.Stream(), binary);
         nnet_->Read(ki.Stream(), binary);
         SetBatchnormTestMode(true, &(nnet_->GetNnet()));
@@ -172,17 +503,39 @@ void Model::ReadDataFiles()
                                                                nnet_);
 
     //load decode graph
-    if (stat(hclg_fst_rxfilename_.c_str(), &buffer) == 0) {
+    if (FileExists(hclg_fst_rxfilename_)) {
         KALDI_LOG << "Loading HCLG from " << hclg_fst_rxfilename_;
-        hclg_fst_ = fst::ReadFstKaldiGeneric(hclg_fst_rxfilename_);
+        if (files_) {
+            ModelInput in(files_, hclg_fst_rxfilename_);
+            hclg_fst_ = fst::StdFst::Read(in.Stream(), fst::FstReadOptions(hclg_fst_rxfilename_));
+            if (!hclg_fst_)
+                KALDI_ERR << "Could not read FST from " << hclg_fst_rxfilename_;
+        } else {
+            hclg_fst_ = fst::ReadFstKaldiGeneric(hclg_fst_rxfilename_);
+        }
         hcl_fst_ = NULL;
         g_fst_ = NULL;
+    } else if (!kVoskLookahead) {
+        KALDI_ERR << "Built without lookahead composition, " << hclg_fst_rxfilename_ << " is required";
     } else {
         KALDI_LOG << "Loading HCL and G from " << hcl_fst_rxfilename_ << " " << g_fst_rxfilename_;
         hclg_fst_ = NULL;
-        hcl_fst_ = fst::StdFst::Read(hcl_fst_rxfilename_);
-        g_fst_ = fst::StdFst::Read(g_fst_rxfilename_);
-        ReadIntegerVectorSimple(disambig_rxfilename_, &disambig_);
+        {
+            ModelInput in(files_, hcl_fst_rxfilename_);
+            hcl_fst_ = fst::StdFst::Read(in.Stream(), fst::FstReadOptions(hcl_fst_rxfilename_));
+        }
+        {
+            ModelInput in(files_, g_fst_rxfilename_);
+            g_fst_ = fst::StdFst::Read(in.Stream(), fst::FstReadOptions(g_fst_rxfilename_));
+        }
+        if (!hcl_fst_ || !g_fst_)
+            KALDI_ERR << "Could not read HCL and G from " << langmodel_path_str_;
+        {
+            ModelInput in(files_, disambig_rxfilename_);
+            int32 id;
+            while (in.Stream() >> id)
+                disambig_.push_back(id);
+        }
     }
 
     //load word symbol
@@ -194,41 +547,64 @@ void Model::ReadDataFiles()
     }
     if (!word_syms_) {
         KALDI_LOG << "Loading words from " << word_syms_rxfilename_;
-        if (!(word_syms_ = fst::SymbolTable::ReadText(word_syms_rxfilename_)))
+        ModelInput in(files_, word_syms_rxfilename_);
+        if (!(word_syms_ = fst::SymbolTable::ReadText(in.Stream(), word_syms_rxfilename_)))
             KALDI_ERR << "Could not read symbol table from file "
                       << word_syms_rxfilename_;
     }
     KALDI_ASSERT(word_syms_);
 
     //load word boundary used to compute word timestamps
-    if (stat(winfo_rxfilename_.c_str(), &buffer) == 0) {
+    if (FileExists(winfo_rxfilename_)) {
         KALDI_LOG << "Loading winfo " << winfo_rxfilename_;
         kaldi::WordBoundaryInfoNewOpts opts;
-        winfo_ = new kaldi::WordBoundaryInfo(opts, winfo_rxfilename_);
+        ModelInput in(files_, winfo_rxfilename_);
+        winfo_ = new kaldi::WordBoundaryInfo(opts);
+        winfo_->Init(in.Stream());
     } else {
         winfo_ = NULL;
     }
 
+    //load phone symbols used to name the phones of forced alignment
+    phone_syms_ = NULL;
+    if (FileExists(phone_syms_rxfilename_)) {
+        KALDI_LOG << "Loading phones from " << phone_syms_rxfilename_;
+        ModelInput in(files_, phone_syms_rxfilename_);
+        if (!(phone_syms_ = fst::SymbolTable::ReadText(in.Stream(), phone_syms_rxfilename_)))
+            KALDI_WARN << "Could not read symbol table from file " << phone_syms_rxfilename_;
+    }
+
     //load rescoring graphs
-    if (stat(carpa_rxfilename_.c_str(), &buffer) == 0) {
+#ifndef VOSK_DISABLE_RESCORE
+    if (FileExists(carpa_rxfilename_)) {
         KALDI_LOG << "Loading CARPA model from " << carpa_rxfilename_;
-        std_lm_fst_ = fst::ReadFstKaldi(std_fst_rxfilename_);
+        {
+            ModelInput in(files_, std_fst_rxfilename_);
+            std_lm_fst_ = fst::VectorFst<fst::StdArc>::Read(in.Stream(), fst::FstReadOptions(std_fst_rxfilename_));
+            if (!std_lm_fst_)
+                KALDI_ERR << "Could not read FST from " << std_fst_rxfilename_;
+        }
         fst::Project(std_lm_fst_, fst::PROJECT_OUTPUT);
         if (std_lm_fst_->Properties(fst::kILabelSorted, true) == 0) {
             fst::ILabelCompare<fst::StdArc> ilabel_comp;
             fst::ArcSort(std_lm_fst_, ilabel_comp);
         }
-        ReadKaldiObject(carpa_rxfilename_, &const_arpa_);
+        ReadObject(carpa_rxfilename_, &const_arpa_);
     } else {
         std_lm_fst_ = NULL;
     }
+#else
+    if (FileExists(carpa_rxfilename_))
+        KALDI_LOG << "Built without rescoring, ignoring " << carpa_rxfilename_;
+    std_lm_fst_ = NULL;
+#endif
 
     //load cmvn matrix used during ivector extraction
     if (feature_config_.global_cmvn_stats_rxfilename != "")
     {
         KALDI_LOG << "Loading global CMVN stats from " << feature_config_.global_cmvn_stats_rxfilename;
-        ReadKaldiObject(feature_config_.global_cmvn_stats_rxfilename,
-                      &global_cmvn_stats_);
+        ReadObject(ConfigPath(feature_config_.global_cmvn_stats_rxfilename),
+                   &global_cmvn_stats_);
     }
     cmvn_state_ = new kaldi::OnlineCmvnState (global_cmvn_stats_);
 
@@ -286,6 +662,83 @@ void Model::Debug()
     KALDI_LOG << decodable_opts_.frames_per_chunk;
 }
 
+int64 FstMemoryUsage(const fst::Fst<fst::StdArc> &fst)
+{
+    int64 num_states = 0, num_arcs = 0;
+    for (fst::StateIterator<fst::Fst<fst::StdArc> > siter(fst); !siter.Done(); siter.Next()) {
+        num_states++;
+        num_arcs += fst.NumArcs(siter.Value());
+    }
+    // State keeps final weight, arc offset and epsilon counts
+    return num_states * (sizeof(fst::StdArc::Weight) + 3 * sizeof(int32)) + num_arcs * sizeof(fst::StdArc);
+}
+
+// Quick estimate for the metrics, the graphs take about the size of their
+// files in memory
+int64 Model::EstimateMemoryUsage()
+{
+    int64 bytes = (int64)nnet3::NumParameters(nnet_->GetNnet()) * (int64)sizeof(BaseFloat);
+    if (hclg_fst_) {
+        bytes += FileSize(files_, hclg_fst_rxfilename_);
+    } else {
+        bytes += FileSize(files_, hcl_fst_rxfilename_) + FileSize(files_, g_fst_rxfilename_);
+    }
+    if (std_lm_fst_)
+        bytes += FileSize(files_, std_fst_rxfilename_) + carpa_bytes_;
+    return bytes;
+}
+
+// Memory of the model components, the graphs and the neural network are
+// estimated from their structure, CARPA is stored as a single array of
+// the file size
+void Model::ComputeMemoryUsage()
+{
+    json::JSON usage;
+
+    usage["nnet"] = (int64)nnet3::NumParameters(nnet_->GetNnet()) * (int64)sizeof(BaseFloat);
+    if (hclg_fst_) {
+        usage["graph"] = FstMemoryUsage(*hclg_fst_);
+    } else {
+        usage["graph"] = FstMemoryUsage(*hcl_fst_) + FstMemoryUsage(*g_fst_);
+    }
+
+    int64 symbols = 0;
+    for (fst::SymbolTableIterator siter(*word_syms_); !siter.Done(); siter.Next()) {
+        symbols += siter.Symbol().size() + 2 * sizeof(int64);
+    }
+    usage["symbols"] = symbols;
+
+    if (std_lm_fst_) {
+        usage["rescore_g"] = FstMemoryUsage(*std_lm_fst_);
+        usage["carpa"] = carpa_bytes_;
+    } else {
+        usage["rescore_g"] = 0;
+        usage["carpa"] = 0;
+    }
+
+    int64 total = 0;
+    for (auto &p : usage.ObjectRange()) {
+        total += p.second.ToInt();
+    }
+    usage["total"] = total;
+    memory_usage_ = usage.dump();
+}
+
+const char *Model::GetMemoryUsage()
+{
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    if (memory_usage_.empty())
+        ComputeMemoryUsage();
+    return memory_usage_.c_str();
+}
+
+const char *Model::GetCacheStats()
+{
+    if (!fingerprint_cache_)
+        return "{}";
+    return fingerprint_cache_->GetStats();
+}
+
 int Model::getSampleFreq()
 {
   return sample_frequence_;
@@ -298,18 +751,21 @@ void Model::Ref()
 
 void Model::Unref() 
 {
-    ref_cnt_--;
-    if (ref_cnt_ == 0) {
+    if (--ref_cnt_ == 0) {
         delete this;
     }
 }
 
 Model::~Model() {
+    Metrics::Get().ModelReleased(memory_bytes_);
+
     delete decodable_info_;
     delete trans_model_;
     delete nnet_;
     delete winfo_;
+    delete phone_syms_;
     delete hclg_fst_;
     delete hcl_fst_;
     delete g_fst_;
+    delete fingerprint_cache_;
 }
@@ -26,31 +26,160 @@
 #include "lat/lattice-functions.h"
 #include "lat/sausages.h"
 #include "lat/word-align-lattice.h"
+#ifndef VOSK_DISABLE_RESCORE
 #include "lm/const-arpa-lm.h"
+#endif
 #include "util/parse-options.h"
 #include "nnet3/nnet-utils.h"
 #include "rnnlm/rnnlm-utils.h"
 
+#include "build_options.h"
+#include "fingerprint_cache.h"
+
+#include <atomic>
+#include <mutex>
+
 using namespace kaldi;
 using namespace std;
 
 class KaldiRecognizer;
+class Aligner;
+
+// Estimated memory held by the states and arcs of the FST
+int64 FstMemoryUsage(const fst::Fst<fst::StdArc> &fst);
+
+// Model files held in memory
+//
+// Files are named by their path in the model layout, "am/final.mdl",
+// "graph/HCLG.fst" and so on. Paths referenced from the configs, like the
+// i-vector extractor files in online.conf, resolve to the file sharing
+// the longest run of trailing path components, so configs written for
+// any model location work unchanged. The buffers are not copied and must
+// stay valid until the model is loaded.
+class ModelFiles {
+
+public:
+    void Add(const string &name, const char *data, size_t size);
+    // Adds the files of a tar archive, returns false if it is malformed
+    bool AddTar(const char *data, size_t size);
+    // Finds a file of the model layout, like "am/final.mdl", by its full
+    // path, possibly under the top directory common to all files
+    bool Find(const string &path, const char **data, size_t *size) const;
+    // Returns the name of the file sharing the longest trailing part with
+    // a path read from a config, which was written on the machine the
+    // model was built on, or the path itself if none does
+    string MatchSuffix(const string &path) const;
+
+private:
+    struct File {
+        string name;
+        const char *data;
+        size_t size;
+    };
+    vector<File> files_;
+    string root_; // Top directory with a trailing slash, empty if none
+};
+
+// Endpoints an utterance as soon as the best path stops changing and can
+// end in a final state of the graph, without waiting for the trailing
+// silence of the OnlineEndpointConfig rules, which still apply
+struct StableEndpointConfig {
+    bool enabled;
+    BaseFloat stable_duration;
+    BaseFloat max_final_relative_cost;
+    BaseFloat min_trailing_silence;
+    BaseFloat check_interval;
+
+    StableEndpointConfig() : enabled(false), stable_duration(0.3),
+        max_final_relative_cost(2.0), min_trailing_silence(0.1), check_interval(0.1) { }
+
+    void Register(OptionsItf *opts) {
+        opts->Register("endpoint.stable.enabled", &enabled, "If true, also endpoint "
+                       "when the best path is stable and can end the utterance");
+        opts->Register("endpoint.stable.duration", &stable_duration, "Time in seconds "
+                       "the words of the best path must stay unchanged");
+        opts->Register("endpoint.stable.max-final-relative-cost", &max_final_relative_cost,
+                       "Maximum difference between the best final cost and the best "
+                       "cost, lower values require a more certain utterance end");
+        opts->Register("endpoint.stable.min-trailing-silence", &min_trailing_silence,
+                       "Minimum trailing silence in seconds, used if silence phones are set");
+        opts->Register("endpoint.stable.check-interval", &check_interval, "Time in seconds "
+                       "between checks of the best path, the stable time is measured in these steps");
+    }
+};
+
+// Endpoints an utterance of a grammar recognizer as soon as the best path
+// ends in a final state of the grammar and leads every token that could
+// still extend it, a command is then complete without trailing silence
+struct GrammarEndpointConfig {
+    bool enabled;
+    BaseFloat min_final_lead;
+    BaseFloat min_final_duration;
+
+    GrammarEndpointConfig() : enabled(false), min_final_lead(1.0),
+        min_final_duration(0.15) { }
+
+    void Register(OptionsItf *opts) {
+        opts->Register("endpoint.grammar.enabled", &enabled, "If true, grammar "
+                       "recognizers endpoint when the best path completes the grammar");
+        opts->Register("endpoint.grammar.min-final-lead", &min_final_lead,
+                       "Minimum cost by which the best final token must beat the "
+                       "best token that is not final");
+        opts->Register("endpoint.grammar.min-final-duration", &min_final_duration,
+                       "Time in seconds the best final token must keep its lead");
+    }
+};
+
+// Beams of forced alignment, the graph allows a single word sequence so
+// beams much narrower than for recognition are enough. Utterances which
+// don't reach the end of the transcript are decoded again with the retry
+// beam.
+struct AlignerConfig {
+    BaseFloat beam;
+    BaseFloat retry_beam;
+    BaseFloat lattice_beam;
+    int32 max_active;
+
+    AlignerConfig() : beam(10.0), retry_beam(40.0), lattice_beam(1.0), max_active(2000) { }
+
+    void Register(OptionsItf *opts) {
+        opts->Register("align.beam", &beam, "Decoding beam of forced alignment");
+        opts->Register("align.retry-beam", &retry_beam, "Beam of the second attempt "
+                       "when alignment fails with the first beam, 0 disables retries");
+        opts->Register("align.lattice-beam", &lattice_beam, "Lattice beam of forced alignment");
+        opts->Register("align.max-active", &max_active, "Maximum active states of forced alignment");
+    }
+};
 
 class Model {
 
 public:
     Model(const char *acmodel_path, const char *langmodel_path, const char *config_file_path);
+    // Loads the model from memory, without filesystem access
+    Model(const ModelFiles &files);
     void Ref();
     void Unref();
     int getSampleFreq();
+    const char *GetMemoryUsage();
+    const char *GetCacheStats();
 
 protected:
     ~Model();
+    void Load();
     void Configure();
     void ReadDataFiles();
+    void ReadFeatureInfo();
+    string ConfigPath(const string &path);
+    bool FileExists(const string &path);
+    string ReadText(const string &path);
+    template <class C> void ReadObject(const string &path, C *c);
+    template <class C> void ReadOptions(const string &path, C *opts);
+    int64 EstimateMemoryUsage();
+    void ComputeMemoryUsage();
     void Debug();
 
     friend class KaldiRecognizer;
+    friend class Aligner;
 
     string acmodel_path_str_;
     string langmodel_path_str_;
@@ -62,12 +191,18 @@ protected:
     string disambig_rxfilename_;
     string word_syms_rxfilename_;
     string winfo_rxfilename_;
+    string phone_syms_rxfilename_;
     string carpa_rxfilename_;
     string std_fst_rxfilename_;
     string final_ie_rxfilename_;
     string mfcc_conf_rxfilename_;
+    const ModelFiles *files_; // Model files in memory, only set while loading
 
     kaldi::OnlineEndpointConfig endpoint_config_;
+    StableEndpointConfig stable_endpoint_config_;
+    GrammarEndpointConfig grammar_endpoint_config_;
+    FingerprintCacheConfig fingerprint_cache_config_;
+    AlignerConfig aligner_config_;
     kaldi::LatticeFasterDecoderConfig nnet3_decoding_config_;
     kaldi::OnlineNnet2FeaturePipelineConfig feature_config_;
     kaldi::nnet3::NnetSimpleLoopedComputationOptions decodable_opts_;
@@ -78,6 +213,7 @@ protected:
     kaldi::nnet3::AmNnetSimple *nnet_;
     const fst::SymbolTable *word_syms_;
     kaldi::WordBoundaryInfo *winfo_;
+    const fst::SymbolTable *phone_syms_; // NULL if the model has no phones.txt
     vector<int32> disambig_;
     Matrix<double> global_cmvn_stats_;
     kaldi::OnlineCmvnState *cmvn_state_;
@@ -89,10 +225,21 @@ protected:
     fst::Fst<fst::StdArc> *g_fst_;
 
     fst::VectorFst<fst::StdArc> *std_lm_fst_;
+#ifndef VOSK_DISABLE_RESCORE
     kaldi::ConstArpaLm const_arpa_;
+#endif
+
+    FingerprintCache *fingerprint_cache_; // NULL unless enabled in the config
 
-    int ref_cnt_;
+    std::atomic<int> ref_cnt_; // objects are released on any thread
     int sample_frequence_;
+    // JSON report of the memory owned by the model components, computed on
+    // the first request since walking a large graph takes seconds. The
+    // metrics get a quick estimate made on load.
+    std::mutex memory_mutex_;
+    int64 carpa_bytes_;
+    int64 memory_bytes_;
+    string memory_usage_;
 };
 
 #endif /* MODEL_H_ */
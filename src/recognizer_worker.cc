@@ -0,0 +1,141 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "recognizer_worker.h"
+
+#include "base/kaldi-common.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+RecognizerWorker::RecognizerWorker(VoskRecognizer *recognizer, bool partial_results) :
+    recognizer_(recognizer), partial_results_(partial_results), pending_(0), finish_(false), stop_(false), done_(false)
+{
+    if (pipe(pipe_) != 0) {
+        KALDI_ERR << "Can't create result pipe";
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(pipe_[i], F_SETFL, fcntl(pipe_[i], F_GETFL) | O_NONBLOCK);
+        fcntl(pipe_[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    thread_ = std::thread(&RecognizerWorker::Run, this);
+}
+
+RecognizerWorker::~RecognizerWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_one();
+    thread_.join();
+
+    close(pipe_[0]);
+    close(pipe_[1]);
+}
+
+void RecognizerWorker::Feed(const char *data, int len)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finish_)
+            return;
+        input_.push_back(std::string(data, len));
+        pending_ += len;
+    }
+    cond_.notify_one();
+}
+
+size_t RecognizerWorker::Pending()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_;
+}
+
+void RecognizerWorker::Finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finish_ = true;
+    }
+    cond_.notify_one();
+}
+
+const char *RecognizerWorker::PopResult()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty())
+        return NULL;
+    last_result_.swap(results_.front());
+    results_.pop_front();
+    return last_result_.c_str();
+}
+
+bool RecognizerWorker::Done()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return done_;
+}
+
+void RecognizerWorker::PushResult(const char *result)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.push_back(result);
+    }
+    Signal('r');
+}
+
+void RecognizerWorker::Signal(char c)
+{
+    // A full pipe already wakes up the reader, so the error is ignored
+    ssize_t ret = write(pipe_[1], &c, 1);
+    (void)ret;
+}
+
+void RecognizerWorker::Run()
+{
+    try {
+        while (true) {
+            std::string chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this] { return stop_ || finish_ || !input_.empty(); });
+                if (stop_)
+                    return;
+                if (input_.empty())
+                    break;
+                chunk.swap(input_.front());
+                input_.pop_front();
+                pending_ -= chunk.size();
+            }
+            Signal('a');
+
+            if (vosk_recognizer_accept_waveform(recognizer_, chunk.data(), chunk.size()))
+                PushResult(vosk_recognizer_result(recognizer_));
+            else if (partial_results_)
+                PushResult(vosk_recognizer_partial_result(recognizer_));
+        }
+        PushResult(vosk_recognizer_final_result(recognizer_));
+    } catch (const std::exception &e) {
+        KALDI_WARN << "Recognizer worker failed: " << e.what();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_ = true;
+    }
+    Signal('d');
+}
@@ -0,0 +1,68 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RECOGNIZER_WORKER_H_
+#define RECOGNIZER_WORKER_H_
+
+#include "vosk_api.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Decodes the audio of a recognizer in a background thread
+//
+// Feed only queues a copy of the data, results are queued by the thread
+// and signaled by a byte written to a non-blocking pipe, so an event loop
+// can wait for the results of many recognizers on their descriptors. The
+// pipe is also signaled when the thread takes audio from the queue, so a
+// feeder can wait for the queue to drain on the same descriptor.
+class RecognizerWorker {
+
+public:
+    RecognizerWorker(VoskRecognizer *recognizer, bool partial_results);
+    ~RecognizerWorker();
+
+    int Fd() const { return pipe_[0]; };
+    void Feed(const char *data, int len);
+    size_t Pending();
+    void Finish();
+    const char *PopResult();
+    bool Done();
+
+private:
+    void Run();
+    void PushResult(const char *result);
+    void Signal(char c);
+
+    VoskRecognizer *recognizer_;
+    bool partial_results_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::string> input_;
+    size_t pending_;
+    std::deque<std::string> results_;
+    bool finish_;
+    bool stop_;
+    bool done_;
+
+    std::string last_result_;
+    int pipe_[2];
+    std::thread thread_;
+};
+
+#endif /* RECOGNIZER_WORKER_H_ */
@@ -0,0 +1,119 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "recorder.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+static std::mutex record_mutex;
+static std::string record_dir;
+static std::atomic<int> record_count(0);
+
+bool Recorder::Start(const char *dir)
+{
+    struct stat buffer;
+    if (stat(dir, &buffer) != 0 || !S_ISDIR(buffer.st_mode))
+        return false;
+
+    std::lock_guard<std::mutex> lock(record_mutex);
+    record_dir = dir;
+    return true;
+}
+
+void Recorder::Stop()
+{
+    std::lock_guard<std::mutex> lock(record_mutex);
+    record_dir.clear();
+}
+
+Recorder *Recorder::Create(float sample_frequency, bool online, const char *grammar, bool speaker)
+{
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(record_mutex);
+        if (record_dir.empty())
+            return NULL;
+        path = record_dir + "/vosk-" + std::to_string(getpid()) + "-" + std::to_string(++record_count) + ".rec";
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return NULL;
+
+    uint32_t version = RECORDER_VERSION;
+    uint8_t online_flag = online, speaker_flag = speaker;
+    uint32_t grammar_len = grammar ? strlen(grammar) : 0;
+
+    fwrite("VREC", 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(&sample_frequency, sizeof(sample_frequency), 1, file);
+    fwrite(&online_flag, 1, 1, file);
+    fwrite(&speaker_flag, 1, 1, file);
+    fwrite(&grammar_len, sizeof(grammar_len), 1, file);
+    if (grammar_len)
+        fwrite(grammar, 1, grammar_len, file);
+
+    return new Recorder(file);
+}
+
+Recorder::~Recorder()
+{
+    fclose(file_);
+}
+
+int64_t Recorder::NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Recorder::WriteRecordHeader(RecordType type, int64_t start_us)
+{
+    uint8_t record_type = type;
+    int64_t start = start_us - start_us_;
+    int64_t duration = NowUs() - start_us;
+
+    fwrite(&record_type, 1, 1, file_);
+    fwrite(&start, sizeof(start), 1, file_);
+    fwrite(&duration, sizeof(duration), 1, file_);
+}
+
+void Recorder::Accept(RecordFormat format, const void *data, int len, int64_t start_us, bool endpoint)
+{
+    WriteRecordHeader(RECORD_ACCEPT, start_us);
+
+    uint8_t record_format = format, endpoint_flag = endpoint;
+    uint32_t length = len;
+    size_t sample_size = format == RECORD_FLOAT ? sizeof(float) : format == RECORD_SHORT ? sizeof(short) : 1;
+
+    fwrite(&record_format, 1, 1, file_);
+    fwrite(&endpoint_flag, 1, 1, file_);
+    fwrite(&length, sizeof(length), 1, file_);
+    fwrite(data, sample_size, len, file_);
+}
+
+void Recorder::Result(RecordType type, const char *result, int64_t start_us)
+{
+    WriteRecordHeader(type, start_us);
+
+    uint32_t len = strlen(result);
+    fwrite(&len, sizeof(len), 1, file_);
+    fwrite(result, 1, len, file_);
+}
@@ -0,0 +1,76 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RECORDER_H_
+#define RECORDER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+// Records the traffic of a recognizer for later replay with c/vosk_replay
+//
+// File layout, all numbers are little-endian:
+//
+//   header:  "VREC" u32 version, f32 sample frequency, u8 online,
+//            u8 speaker model, u32 grammar length, grammar bytes
+//   record:  u8 type, i64 start us, i64 duration us, payload
+//
+// Accept records carry u8 sample format, u8 endpoint flag, u32 length and
+// the audio. The length is in bytes for RECORD_PCM16, which may hold an
+// odd byte count, and in samples for the other formats. Result records
+// carry u32 length and the JSON. Times are relative to the recognizer
+// creation.
+
+#define RECORDER_VERSION 1
+
+enum RecordType {
+    RECORD_ACCEPT = 1,
+    RECORD_PARTIAL_RESULT,
+    RECORD_RESULT,
+    RECORD_FINAL_RESULT,
+    RECORD_METADATA
+};
+
+enum RecordFormat {
+    RECORD_PCM16 = 0, // bytes of 16-bit PCM
+    RECORD_SHORT,
+    RECORD_FLOAT
+};
+
+class Recorder {
+
+public:
+    // Creates the recorder of a new recognizer if recording is active, otherwise returns NULL
+    static Recorder *Create(float sample_frequency, bool online, const char *grammar, bool speaker);
+    static bool Start(const char *dir);
+    static void Stop();
+
+    ~Recorder();
+
+    void Accept(RecordFormat format, const void *data, int len, int64_t start_us, bool endpoint);
+    void Result(RecordType type, const char *result, int64_t start_us);
+
+    static int64_t NowUs();
+
+private:
+    Recorder(FILE *file) : file_(file), start_us_(NowUs()) {};
+    void WriteRecordHeader(RecordType type, int64_t start_us);
+
+    FILE *file_;
+    int64_t start_us_;
+};
+
+#endif /* RECORDER_H_ */
@@ -0,0 +1,329 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "search_index.h"
+
+#include "json.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#define INDEX_MAGIC "VOSKIDX1"
+
+// Longest pause in seconds between the words of a phrase
+#define INDEX_PHRASE_MAX_GAP 0.5
+
+SearchIndexWriter::SearchIndexWriter(BaseFloat min_posterior) : min_posterior_(min_posterior)
+{
+}
+
+void SearchIndexWriter::Add(const string &doc, const vector<IndexHit> &hits)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto doc_it = doc_ids_.find(doc);
+    if (doc_it == doc_ids_.end()) {
+        doc_it = doc_ids_.insert(make_pair(doc, (uint32_t)docs_.size())).first;
+        docs_.push_back(doc);
+    }
+
+    for (size_t i = 0; i < hits.size(); i++) {
+        const IndexHit &hit = hits[i];
+        if (hit.posterior < min_posterior_)
+            continue;
+
+        auto term_it = term_ids_.find(hit.word);
+        if (term_it == term_ids_.end()) {
+            term_it = term_ids_.insert(make_pair(hit.word, (uint32_t)terms_.size())).first;
+            terms_.push_back(hit.word);
+        }
+
+        Entry entry;
+        entry.term = term_it->second;
+        entry.posting.doc = doc_it->second;
+        entry.posting.start = hit.start;
+        entry.posting.end = hit.end;
+        entry.posting.posterior = hit.posterior;
+        entries_.push_back(entry);
+    }
+}
+
+static bool WriteAll(FILE *out, const void *data, size_t size)
+{
+    return size == 0 || fwrite(data, size, 1, out) == 1;
+}
+
+bool SearchIndexWriter::Save(const char *path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Terms are renumbered in sorted order
+    vector<uint32_t> order(terms_.size()), rank(terms_.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return terms_[a] < terms_[b]; });
+    for (size_t i = 0; i < order.size(); i++)
+        rank[order[i]] = i;
+
+    vector<Entry> entries(entries_);
+    for (size_t i = 0; i < entries.size(); i++)
+        entries[i].term = rank[entries[i].term];
+    sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        if (a.term != b.term)
+            return a.term < b.term;
+        if (a.posting.doc != b.posting.doc)
+            return a.posting.doc < b.posting.doc;
+        return a.posting.start < b.posting.start;
+    });
+
+    string strings;
+    vector<uint64_t> doc_offsets, term_offsets, term_postings;
+    for (size_t i = 0; i < docs_.size(); i++) {
+        doc_offsets.push_back(strings.size());
+        strings += docs_[i];
+    }
+    doc_offsets.push_back(strings.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        term_offsets.push_back(strings.size());
+        strings += terms_[order[i]];
+    }
+    term_offsets.push_back(strings.size());
+
+    vector<IndexPosting> postings(entries.size());
+    size_t term = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        while (term <= entries[i].term) {
+            term_postings.push_back(i);
+            term++;
+        }
+        postings[i] = entries[i].posting;
+    }
+    while (term_postings.size() <= terms_.size())
+        term_postings.push_back(entries.size());
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.num_docs = docs_.size();
+    header.num_terms = terms_.size();
+    header.num_postings = postings.size();
+    header.doc_offsets = sizeof(header);
+    header.term_offsets = header.doc_offsets + doc_offsets.size() * sizeof(uint64_t);
+    header.term_postings = header.term_offsets + term_offsets.size() * sizeof(uint64_t);
+    header.postings = header.term_postings + term_postings.size() * sizeof(uint64_t);
+    header.strings = header.postings + postings.size() * sizeof(IndexPosting);
+    header.strings_size = strings.size();
+
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        KALDI_WARN << "Can't open " << path;
+        return false;
+    }
+    bool ok = WriteAll(out, &header, sizeof(header)) &&
+              WriteAll(out, doc_offsets.data(), doc_offsets.size() * sizeof(uint64_t)) &&
+              WriteAll(out, term_offsets.data(), term_offsets.size() * sizeof(uint64_t)) &&
+              WriteAll(out, term_postings.data(), term_postings.size() * sizeof(uint64_t)) &&
+              WriteAll(out, postings.data(), postings.size() * sizeof(IndexPosting)) &&
+              WriteAll(out, strings.data(), strings.size());
+    ok = fclose(out) == 0 && ok;
+    if (!ok)
+        KALDI_WARN << "Can't write " << path;
+    return ok;
+}
+
+SearchIndex::SearchIndex() : map_(NULL), map_size_(0)
+{
+}
+
+SearchIndex::~SearchIndex()
+{
+    if (map_)
+        munmap((void *)map_, map_size_);
+}
+
+bool SearchIndex::Open(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        KALDI_WARN << "Can't open " << path;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexHeader)) {
+        KALDI_WARN << "Can't read " << path;
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        KALDI_WARN << "Can't map " << path;
+        return false;
+    }
+
+    map_ = (const char *)map;
+    map_size_ = st.st_size;
+    header_ = (const IndexHeader *)map_;
+
+    if (!Validate()) {
+        KALDI_WARN << "Invalid index file " << path;
+        return false;
+    }
+
+    doc_offsets_ = (const uint64_t *)(map_ + header_->doc_offsets);
+    term_offsets_ = (const uint64_t *)(map_ + header_->term_offsets);
+    term_postings_ = (const uint64_t *)(map_ + header_->term_postings);
+    postings_ = (const IndexPosting *)(map_ + header_->postings);
+    strings_ = map_ + header_->strings;
+    return true;
+}
+
+// Checks the sections fit the file and the offsets stay in range, so
+// searches need no checks
+bool SearchIndex::Validate()
+{
+    const IndexHeader &h = *header_;
+    if (memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) != 0)
+        return false;
+
+    uint64_t docs_size = ((uint64_t)h.num_docs + 1) * sizeof(uint64_t);
+    uint64_t terms_size = ((uint64_t)h.num_terms + 1) * sizeof(uint64_t);
+    if (h.num_postings > map_size_ / sizeof(IndexPosting))
+        return false;
+    if (h.doc_offsets != sizeof(IndexHeader) ||
+        h.term_offsets != h.doc_offsets + docs_size ||
+        h.term_postings != h.term_offsets + terms_size ||
+        h.postings != h.term_postings + terms_size ||
+        h.strings != h.postings + h.num_postings * sizeof(IndexPosting) ||
+        h.strings > map_size_ || h.strings_size > map_size_ - h.strings)
+        return false;
+
+    const uint64_t *doc_offsets = (const uint64_t *)(map_ + h.doc_offsets);
+    const uint64_t *term_offsets = (const uint64_t *)(map_ + h.term_offsets);
+    const uint64_t *term_postings = (const uint64_t *)(map_ + h.term_postings);
+    for (uint32_t i = 0; i < h.num_docs; i++) {
+        if (doc_offsets[i] > doc_offsets[i + 1])
+            return false;
+    }
+    for (uint32_t i = 0; i < h.num_terms; i++) {
+        if (term_offsets[i] > term_offsets[i + 1] || term_postings[i] > term_postings[i + 1])
+            return false;
+    }
+    if (doc_offsets[h.num_docs] > h.strings_size || term_offsets[h.num_terms] > h.strings_size ||
+        term_postings[h.num_terms] != h.num_postings)
+        return false;
+
+    const IndexPosting *postings = (const IndexPosting *)(map_ + h.postings);
+    for (uint64_t i = 0; i < h.num_postings; i++) {
+        if (postings[i].doc >= h.num_docs)
+            return false;
+    }
+    return true;
+}
+
+string SearchIndex::Name(const uint64_t *offsets, size_t i) const
+{
+    return string(strings_ + offsets[i], offsets[i + 1] - offsets[i]);
+}
+
+bool SearchIndex::FindTerm(const string &term, uint64_t *begin, uint64_t *end) const
+{
+    size_t lo = 0, hi = header_->num_terms;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = Name(term_offsets_, mid).compare(term);
+        if (cmp == 0) {
+            *begin = term_postings_[mid];
+            *end = term_postings_[mid + 1];
+            return true;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return false;
+}
+
+const char *SearchIndex::Search(const char *query, BaseFloat min_score, int max_results)
+{
+    vector<string> words;
+    stringstream ss(query);
+    string word;
+    while (ss >> word)
+        words.push_back(word);
+
+    vector<uint64_t> begin(words.size()), end(words.size());
+    bool found = !words.empty();
+    for (size_t i = 0; i < words.size() && found; i++)
+        found = FindTerm(words[i], &begin[i], &end[i]);
+
+    // Every occurrence of the first word is extended with the best
+    // continuation of each following word
+    vector<Match> matches;
+    for (uint64_t p = found ? begin[0] : 0; found && p < end[0]; p++) {
+        Match match = { postings_[p].doc, postings_[p].start, postings_[p].end, postings_[p].posterior };
+        float last_start = match.start;
+
+        for (size_t i = 1; i < words.size() && match.score >= min_score; i++) {
+            const IndexPosting *first = postings_ + begin[i], *last = postings_ + end[i];
+            uint32_t doc = match.doc;
+            const IndexPosting *next = partition_point(first, last, [doc, last_start](const IndexPosting &a) {
+                return a.doc < doc || (a.doc == doc && a.start <= last_start);
+            });
+            const IndexPosting *best = NULL;
+            for (; next < last && next->doc == match.doc && next->start <= match.end + INDEX_PHRASE_MAX_GAP; next++) {
+                if (!best || next->posterior > best->posterior)
+                    best = next;
+            }
+            if (!best) {
+                match.score = 0;
+                break;
+            }
+            match.end = best->end;
+            match.score *= best->posterior;
+            last_start = best->start;
+        }
+        if (match.score >= min_score && match.score > 0)
+            matches.push_back(match);
+    }
+
+    size_t count = max_results > 0 && (size_t)max_results < matches.size() ? max_results : matches.size();
+    partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const Match &a, const Match &b) {
+        return a.score > b.score;
+    });
+
+    json::JSON result;
+    result["query"] = string(query);
+    result["results"] = json::JSON::Make(json::JSON::Class::Array);
+    for (size_t i = 0; i < count; i++) {
+        json::JSON match;
+        match["doc"] = Name(doc_offsets_, matches[i].doc);
+        match["start"] = matches[i].start;
+        match["end"] = matches[i].end;
+        match["score"] = matches[i].score;
+        result["results"].append(match);
+    }
+    result_ = result.dump();
+    return result_.c_str();
+}
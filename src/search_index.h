@@ -0,0 +1,138 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SEARCH_INDEX_H_
+#define SEARCH_INDEX_H_
+
+#include "base/kaldi-common.h"
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace kaldi;
+using namespace std;
+
+// Index file layout, all fields in host byte order and 8-byte aligned:
+//
+//   IndexHeader
+//   uint64 doc_offsets[num_docs + 1]       document names in the string data
+//   uint64 term_offsets[num_terms + 1]     terms in the string data, sorted
+//   uint64 term_postings[num_terms + 1]    first posting of each term
+//   IndexPosting postings[num_postings]    sorted by term, document and time
+//   char strings[]                         names and terms, not terminated
+struct IndexHeader {
+    char magic[8];
+    uint32_t num_docs;
+    uint32_t num_terms;
+    uint64_t num_postings;
+    uint64_t doc_offsets;
+    uint64_t term_offsets;
+    uint64_t term_postings;
+    uint64_t postings;
+    uint64_t strings;
+    uint64_t strings_size;
+};
+
+// Occurrence of a term, times in seconds from the start of the document
+struct IndexPosting {
+    uint32_t doc;
+    float start;
+    float end;
+    float posterior;
+};
+
+// Word of a confusion network bin with its posterior probability
+struct IndexHit {
+    string word;
+    double start;
+    double end;
+    BaseFloat posterior;
+};
+
+// Collects word posteriors of decoded utterances, shared by recognizers
+// and written to an index file at the end
+//
+// Each utterance contributes every word of its confusion network with the
+// posterior above the minimum, not just the best path, so terms the best
+// path missed are still found with their lower posterior.
+class SearchIndexWriter {
+
+public:
+    SearchIndexWriter(BaseFloat min_posterior);
+
+    void Add(const string &doc, const vector<IndexHit> &hits);
+    // Writes the index, returns false on error
+    bool Save(const char *path);
+
+private:
+    struct Entry {
+        uint32_t term;
+        IndexPosting posting;
+    };
+
+    BaseFloat min_posterior_;
+    std::mutex mutex_;
+
+    unordered_map<string, uint32_t> doc_ids_;
+    vector<string> docs_;
+    unordered_map<string, uint32_t> term_ids_;
+    vector<string> terms_;
+    vector<Entry> entries_;
+};
+
+// Index file mapped into memory
+//
+// Terms are found by binary search, queries of several words match
+// sequences of postings in the same document where each word starts after
+// the previous one and within a short gap after its end. The score of a
+// match is the product of the word posteriors.
+class SearchIndex {
+
+public:
+    SearchIndex();
+    ~SearchIndex();
+
+    bool Open(const char *path);
+    // Returns the matches of the query ordered by score in JSON format
+    const char *Search(const char *query, BaseFloat min_score, int max_results);
+
+private:
+    struct Match {
+        uint32_t doc;
+        float start;
+        float end;
+        float score;
+    };
+
+    bool Validate();
+    bool FindTerm(const string &term, uint64_t *begin, uint64_t *end) const;
+    string Name(const uint64_t *offsets, size_t i) const;
+
+    const char *map_;
+    size_t map_size_;
+    const IndexHeader *header_;
+    const uint64_t *doc_offsets_;
+    const uint64_t *term_offsets_;
+    const uint64_t *term_postings_;
+    const IndexPosting *postings_;
+    const char *strings_;
+
+    string result_;
+};
+
+#endif /* SEARCH_INDEX_H_ */
@@ -14,6 +14,7 @@
 
 #include "spk_model.h"
 
+#ifndef VOSK_DISABLE_SPEAKER
 SpkModel::SpkModel(const char *speaker_path) {
     std::string speaker_path_str(speaker_path);
 
@@ -27,6 +28,7 @@ SpkModel::SpkModel(const char *speaker_path) {
 
     ref_cnt_ = 1;
 }
+#endif
 
 void SpkModel::Ref() 
 {
@@ -35,8 +37,7 @@ void SpkModel::Ref()
 
 void SpkModel::Unref() 
 {
-    ref_cnt_--;
-    if (ref_cnt_ == 0) {
+    if (--ref_cnt_ == 0) {
         delete this;
     }
 }
@@ -19,6 +19,10 @@
 #include "online2/online-feature-pipeline.h"
 #include "nnet3/nnet-utils.h"
 
+#include "build_options.h"
+
+#include <atomic>
+
 using namespace kaldi;
 
 class KaldiRecognizer;
@@ -37,7 +41,7 @@ protected:
     kaldi::nnet3::Nnet speaker_nnet;
     MfccOptions spkvector_mfcc_opts;
 
-    int ref_cnt_;
+    std::atomic<int> ref_cnt_; // objects are released on any thread
 };
 
 #endif /* SPK_MODEL_H_ */
@@ -0,0 +1,116 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "trace.h"
+
+#include <unistd.h>
+#include <chrono>
+
+// Events are kept in memory and written out in batches of this size
+#define TRACE_FLUSH_EVENTS 4096
+
+static int CurrentThreadId()
+{
+    static std::atomic<int> last_thread_id(0);
+    thread_local int thread_id = ++last_thread_id;
+    return thread_id;
+}
+
+Tracer &Tracer::Get()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+int64_t Tracer::NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Tracer::Start(const char *path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+
+    if (file_)
+        return false;
+
+    file_ = fopen(path, "w");
+    if (!file_)
+        return false;
+
+    fprintf(file_, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    first_event_ = true;
+    events_.reserve(TRACE_FLUSH_EVENTS);
+    enabled_.store(true);
+    return true;
+}
+
+void Tracer::Stop()
+{
+    // Waits for the batch being written, if any
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+
+    if (!file_)
+        return;
+
+    enabled_.store(false);
+    Write(events_);
+    events_.clear();
+    fprintf(file_, "\n]}\n");
+    fclose(file_);
+    file_ = NULL;
+}
+
+void Tracer::AddSpan(const char *name, int stream_id, int64_t start_us, int64_t dur_us)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Tracing might be stopped while the span was open
+    if (!file_)
+        return;
+
+    Event event = { name, stream_id, CurrentThreadId(), start_us, dur_us };
+    events_.push_back(event);
+    if (events_.size() < TRACE_FLUSH_EVENTS)
+        return;
+
+    // The full batch is written after the buffer lock is released, so
+    // other threads keep adding spans meanwhile. The file lock is taken
+    // first, batches are written in order and Stop waits for them.
+    std::vector<Event> batch;
+    batch.swap(events_);
+    events_.reserve(TRACE_FLUSH_EVENTS);
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    lock.unlock();
+    Write(batch);
+}
+
+// Must be called with the file mutex held
+void Tracer::Write(const std::vector<Event> &events)
+{
+    int pid = getpid();
+    for (size_t i = 0; i < events.size(); i++) {
+        const Event &e = events[i];
+        fprintf(file_, "%s\n{\"name\": \"%s\", \"cat\": \"vosk\", \"ph\": \"X\", "
+                "\"ts\": %lld, \"dur\": %lld, \"pid\": %d, \"tid\": %d, "
+                "\"args\": {\"stream\": %d}}",
+                first_event_ ? "" : ",", e.name,
+                (long long)e.start_us, (long long)e.dur_us,
+                pid, e.thread_id, e.stream_id);
+        first_event_ = false;
+    }
+}
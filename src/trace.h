@@ -0,0 +1,87 @@
+// Copyright 2020 Alpha Cephei Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//       http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Process-wide recorder of pipeline spans in Chrome trace-event format.
+// The resulting file can be opened in chrome://tracing or ui.perfetto.dev.
+//
+// Tracing is off by default, a disabled TraceSpan costs a single relaxed
+// atomic load.
+class Tracer {
+
+public:
+    static Tracer &Get();
+
+    bool Start(const char *path);
+    void Stop();
+
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    int NewStreamId() { return ++last_stream_id_; }
+    void AddSpan(const char *name, int stream_id, int64_t start_us, int64_t dur_us);
+
+    static int64_t NowUs();
+
+private:
+    Tracer() : enabled_(false), last_stream_id_(0), file_(NULL), first_event_(true) {};
+
+    struct Event {
+        const char *name;
+        int stream_id;
+        int thread_id;
+        int64_t start_us;
+        int64_t dur_us;
+    };
+
+    void Write(const std::vector<Event> &events);
+
+    std::atomic<bool> enabled_;
+    std::atomic<int> last_stream_id_;
+    // Guards the event buffer, the file lock guards writing, taken in this
+    // order
+    std::mutex mutex_;
+    std::mutex file_mutex_;
+    FILE *file_;
+    bool first_event_;
+    std::vector<Event> events_;
+};
+
+// Records the lifetime of the scope as a complete ("X") event
+class TraceSpan {
+
+public:
+    TraceSpan(const char *name, int stream_id) : name_(name), stream_id_(stream_id) {
+        start_us_ = Tracer::Get().Enabled() ? Tracer::NowUs() : -1;
+    }
+    ~TraceSpan() {
+        if (start_us_ >= 0)
+            Tracer::Get().AddSpan(name_, stream_id_, start_us_, Tracer::NowUs() - start_us_);
+    }
+
+private:
+    const char *name_;
+    int stream_id_;
+    int64_t start_us_;
+};
+
+#endif /* TRACE_H_ */
@@ -5,6 +5,7 @@
 #endif
 
 %include <typemaps.i>
+%include <exception.i>
 
 #if SWIGPYTHON
 %include <pybuffer.i>
@@ -16,22 +17,110 @@
 
 #if SWIGPYTHON
 %pybuffer_binary(const char *data, int len);
+
+// AcceptWaveform reads the buffer itself and releases the GIL only after
+// the buffer is acquired, errors are reported as Python exceptions
+%nothread KaldiRecognizer::AcceptWaveform;
+%exception KaldiRecognizer::AcceptWaveform {
+    $action
+    if (PyErr_Occurred()) SWIG_fail;
+}
 #endif
 
 #if SWIGJAVA
 %apply char *BYTE {const char *data};
+
+// Audio arrays are accessed in place between GetPrimitiveArrayCritical and
+// ReleasePrimitiveArrayCritical, the Java wrappers check the length
+%define VOSK_CRITICAL_ARRAY(CTYPE, JNITYPE, JAVATYPE)
+%typemap(jni) const CTYPE *critical "JNITYPE"
+%typemap(jtype) const CTYPE *critical "JAVATYPE[]"
+%typemap(jstype) const CTYPE *critical "JAVATYPE[]"
+%typemap(javain) const CTYPE *critical "$javainput"
+%typemap(in) const CTYPE *critical {
+    $1 = ($1_ltype)JCALL2(GetPrimitiveArrayCritical, jenv, $input, 0);
+    if (!$1) {
+        SWIG_JavaThrowException(jenv, SWIG_JavaOutOfMemoryError, "Can't access the array");
+        return $null;
+    }
+}
+%typemap(freearg) const CTYPE *critical {
+    if ($1)
+        JCALL3(ReleasePrimitiveArrayCritical, jenv, $input, (void *)$1, JNI_ABORT);
+}
+%enddef
+VOSK_CRITICAL_ARRAY(char, jbyteArray, byte)
+VOSK_CRITICAL_ARRAY(short, jshortArray, short)
+VOSK_CRITICAL_ARRAY(float, jfloatArray, float)
+
+// Direct NIO buffers are passed by address
+%typemap(jni) const char *direct "jobject"
+%typemap(jtype) const char *direct "java.nio.Buffer"
+%typemap(jstype) const char *direct "java.nio.Buffer"
+%typemap(javain) const char *direct "$javainput"
+%typemap(in) const char *direct {
+    $1 = (char *)JCALL1(GetDirectBufferAddress, jenv, $input);
+    if (!$1) {
+        SWIG_JavaThrowException(jenv, SWIG_JavaIllegalArgumentException, "Buffer is not direct");
+        return $null;
+    }
+}
+
+%javamethodmodifiers KaldiRecognizer::AcceptWaveformCritical "private";
+%javamethodmodifiers KaldiRecognizer::AcceptWaveformDirect "private";
+
 %typemap(javaimports) KaldiRecognizer %{
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
+import java.nio.ShortBuffer;
 %}
 %typemap(javacode) KaldiRecognizer %{
+  private static void checkLength(int length, int len) {
+    if (len < 0 || len > length)
+      throw new IndexOutOfBoundsException("len " + len + " is out of array bounds " + length);
+  }
   public boolean AcceptWaveform(byte[] data) {
     return AcceptWaveform(data, data.length);
   }
+  public boolean AcceptWaveform(byte[] data, int len) {
+    checkLength(data.length, len);
+    return AcceptWaveformCritical(data, len);
+  }
   public boolean AcceptWaveform(short[] data, int len) {
-    byte[] bdata = new byte[len * 2];
-    ByteBuffer.wrap(bdata).order(ByteOrder.LITTLE_ENDIAN).asShortBuffer().put(data, 0, len);
-    return AcceptWaveform(bdata, bdata.length);
+    checkLength(data.length, len);
+    return AcceptWaveformCritical(data, len);
+  }
+  public boolean AcceptWaveform(float[] data, int len) {
+    checkLength(data.length, len);
+    return AcceptWaveformCritical(data, len);
+  }
+  /** Consumes the remaining bytes of 16-bit PCM, a direct buffer is read in place */
+  public boolean AcceptWaveform(ByteBuffer data) {
+    int len = data.remaining();
+    boolean result;
+    if (data.isDirect()) {
+      result = AcceptWaveformDirect(data, data.position(), len, 1);
+    } else {
+      byte[] bdata = new byte[len];
+      data.duplicate().get(bdata);
+      result = AcceptWaveformCritical(bdata, len);
+    }
+    data.position(data.limit());
+    return result;
+  }
+  /** Consumes the remaining samples, a direct buffer in native byte order is read in place */
+  public boolean AcceptWaveform(ShortBuffer data) {
+    int len = data.remaining();
+    boolean result;
+    if (data.isDirect() && data.order() == ByteOrder.nativeOrder()) {
+      result = AcceptWaveformDirect(data, data.position() * 2, len, 2);
+    } else {
+      short[] sdata = new short[len];
+      data.duplicate().get(sdata);
+      result = AcceptWaveformCritical(sdata, len);
+    }
+    data.position(data.limit());
+    return result;
   }
 %}
 %pragma(java) jniclasscode=%{
@@ -46,6 +135,38 @@ CSHARP_ARRAYS(char, byte)
 %apply char INPUT[] {const char *data};
 %apply float INPUT[] {const float *fdata};
 %apply short INPUT[] {const short *sdata};
+
+// Pinned memory is passed as IntPtr without marshaling
+%apply void *VOID_INT_PTR {const void *ptr};
+
+%typemap(cscode) KaldiRecognizer %{
+  public unsafe bool AcceptWaveform(byte[] data, int offset, int len) {
+    if (offset < 0 || len < 0 || offset + len > data.Length)
+      throw new System.ArgumentOutOfRangeException("len");
+    fixed (byte *p = data) { return AcceptWaveformPtr((System.IntPtr)(p + offset), len); }
+  }
+  public unsafe bool AcceptWaveform(short[] sdata, int offset, int len) {
+    if (offset < 0 || len < 0 || offset + len > sdata.Length)
+      throw new System.ArgumentOutOfRangeException("len");
+    fixed (short *p = sdata) { return AcceptWaveformShortPtr((System.IntPtr)(p + offset), len); }
+  }
+  public unsafe bool AcceptWaveform(float[] fdata, int offset, int len) {
+    if (offset < 0 || len < 0 || offset + len > fdata.Length)
+      throw new System.ArgumentOutOfRangeException("len");
+    fixed (float *p = fdata) { return AcceptWaveformFloatPtr((System.IntPtr)(p + offset), len); }
+  }
+#if NETCOREAPP || NETSTANDARD2_1
+  public unsafe bool AcceptWaveform(System.ReadOnlySpan<byte> data) {
+    fixed (byte *p = data) { return AcceptWaveformPtr((System.IntPtr)p, data.Length); }
+  }
+  public unsafe bool AcceptWaveform(System.ReadOnlySpan<short> sdata) {
+    fixed (short *p = sdata) { return AcceptWaveformShortPtr((System.IntPtr)p, sdata.Length); }
+  }
+  public unsafe bool AcceptWaveform(System.ReadOnlySpan<float> fdata) {
+    fixed (float *p = fdata) { return AcceptWaveformFloatPtr((System.IntPtr)p, fdata.Length); }
+  }
+#endif
+%}
 #endif
 
 
@@ -54,6 +175,9 @@ CSHARP_ARRAYS(char, byte)
 #include <v8.h>
 #include <node.h>
 #include <node_buffer.h>
+#include <uv.h>
+#include <string>
+#include <unordered_set>
 %}
 #endif
 
@@ -62,11 +186,179 @@ CSHARP_ARRAYS(char, byte)
 typedef struct VoskModel Model;
 typedef struct VoskSpkModel SpkModel;
 typedef struct VoskRecognizer KaldiRecognizer;
+typedef struct VoskWorker RecognizerWorker;
+typedef struct VoskAudioFile AudioFile;
+typedef struct VoskAligner Aligner;
+typedef struct VoskIndexWriter IndexWriter;
+typedef struct VoskIndex SearchIndex;
 %}
 
 typedef struct {} Model;
 typedef struct {} SpkModel;
 typedef struct {} KaldiRecognizer;
+typedef struct {} RecognizerWorker;
+typedef struct {} AudioFile;
+typedef struct {} Aligner;
+typedef struct {} IndexWriter;
+typedef struct {} SearchIndex;
+
+#if SWIGJAVASCRIPT
+%{
+// Calls of the recognizer on the libuv thread pool. The recognizer object,
+// the audio buffer and the callback are held by persistent handles until
+// the call completes, the audio is read in place. Recognizers with a call
+// in flight are kept in a set, touched only on the main thread, and their
+// other methods throw until the callback runs.
+typedef v8::Local<v8::Object> VoskJsObject;
+
+static std::unordered_set<VoskRecognizer *> vosk_async_busy;
+
+enum VoskAsyncType {
+    VOSK_ASYNC_ACCEPT,
+    VOSK_ASYNC_RESULT,
+    VOSK_ASYNC_FINAL_RESULT
+};
+
+struct VoskAsyncCall {
+    uv_work_t request;
+    VoskAsyncType type;
+    VoskRecognizer *recognizer;
+    const char *data;
+    size_t length;
+    int endpoint;
+    std::string result;
+    std::string error;
+    v8::Persistent<v8::Object> self;
+    v8::Persistent<v8::Value> buffer;
+    v8::Persistent<v8::Function> callback;
+};
+
+static void VoskAsyncWork(uv_work_t *request)
+{
+    VoskAsyncCall *call = (VoskAsyncCall *)request->data;
+    try {
+        switch (call->type) {
+        case VOSK_ASYNC_ACCEPT:
+            call->endpoint = vosk_recognizer_accept_waveform(call->recognizer, call->data, call->length);
+            break;
+        case VOSK_ASYNC_RESULT:
+            call->result = vosk_recognizer_result(call->recognizer);
+            break;
+        case VOSK_ASYNC_FINAL_RESULT:
+            call->result = vosk_recognizer_final_result(call->recognizer);
+            break;
+        }
+    } catch (const std::exception &e) {
+        call->error = e.what();
+    }
+}
+
+static void VoskAsyncAfter(uv_work_t *request, int status)
+{
+    VoskAsyncCall *call = (VoskAsyncCall *)request->data;
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Function> callback = v8::Local<v8::Function>::New(isolate, call->callback);
+
+    v8::Local<v8::Value> argv[2];
+    if (!call->error.empty()) {
+        argv[0] = v8::Exception::Error(v8::String::NewFromUtf8(isolate, call->error.c_str()).ToLocalChecked());
+        argv[1] = v8::Undefined(isolate);
+    } else if (call->type == VOSK_ASYNC_ACCEPT) {
+        argv[0] = v8::Null(isolate);
+        argv[1] = v8::Boolean::New(isolate, call->endpoint != 0);
+    } else {
+        argv[0] = v8::Null(isolate);
+        argv[1] = v8::String::NewFromUtf8(isolate, call->result.c_str()).ToLocalChecked();
+    }
+
+    // The local handle keeps the recognizer alive through the callback
+    v8::Local<v8::Object> self = v8::Local<v8::Object>::New(isolate, call->self);
+    vosk_async_busy.erase(call->recognizer);
+    call->self.Reset();
+    call->buffer.Reset();
+    call->callback.Reset();
+    delete call;
+
+    node::MakeCallback(isolate, self, callback, 2, argv, node::async_context{0, 0});
+}
+
+static void VoskAsyncQueue(VoskRecognizer *recognizer, VoskJsObject self, VoskAsyncType type, v8::Local<v8::Value> buffer, v8::Local<v8::Value> callback)
+{
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+    const char *error = NULL;
+    if (type == VOSK_ASYNC_ACCEPT && !node::Buffer::HasInstance(buffer))
+        error = "Audio must be a Buffer";
+    else if (!callback->IsFunction())
+        error = "Callback must be a function";
+    if (error) {
+        isolate->ThrowException(v8::Exception::TypeError(v8::String::NewFromUtf8(isolate, error).ToLocalChecked()));
+        return;
+    }
+
+    VoskAsyncCall *call = new VoskAsyncCall();
+    vosk_async_busy.insert(recognizer);
+
+    call->request.data = call;
+    call->type = type;
+    call->recognizer = recognizer;
+    call->data = NULL;
+    call->length = 0;
+    call->endpoint = 0;
+    if (type == VOSK_ASYNC_ACCEPT) {
+        call->data = node::Buffer::Data(buffer);
+        call->length = node::Buffer::Length(buffer);
+        call->buffer.Reset(isolate, buffer);
+    }
+    call->self.Reset(isolate, self);
+    call->callback.Reset(isolate, v8::Local<v8::Function>::Cast(callback));
+
+    uv_queue_work(node::GetCurrentEventLoop(isolate), &call->request, VoskAsyncWork, VoskAsyncAfter);
+}
+%}
+
+// The JS object of the recognizer, passed implicitly to the async calls
+%typemap(in, numinputs=0) VoskJsObject self_object {
+    $1 = args.This();
+}
+
+%define VOSK_ASYNC_GUARD(METHOD)
+%exception KaldiRecognizer::METHOD {
+    if (vosk_async_busy.count(arg1)) {
+        SWIG_Error(SWIG_RuntimeError, "Recognizer has an asynchronous call in flight");
+        SWIG_fail;
+    }
+    $action
+}
+%enddef
+VOSK_ASYNC_GUARD(AcceptWaveform)
+VOSK_ASYNC_GUARD(AcceptWaveformAsync)
+VOSK_ASYNC_GUARD(ResultAsync)
+VOSK_ASYNC_GUARD(FinalResultAsync)
+VOSK_ASYNC_GUARD(Result)
+VOSK_ASYNC_GUARD(PartialResult)
+VOSK_ASYNC_GUARD(FinalResult)
+VOSK_ASYNC_GUARD(GetMetadata)
+VOSK_ASYNC_GUARD(AcceptAudioFile)
+VOSK_ASYNC_GUARD(TranscribeFile)
+VOSK_ASYNC_GUARD(TranscribeFd)
+VOSK_ASYNC_GUARD(uttConfidence)
+VOSK_ASYNC_GUARD(GetMemoryUsage)
+VOSK_ASYNC_GUARD(SetIndex)
+#endif
+
+// Constructors of objects the C API may fail to create raise an error
+// instead of returning a wrapper around NULL
+%define VOSK_CHECK_NEW(CLASS, MESSAGE)
+%exception CLASS::CLASS {
+    $action
+    if (!result)
+        SWIG_exception(SWIG_RuntimeError, MESSAGE);
+}
+%enddef
+VOSK_CHECK_NEW(SpkModel, "Failed to create a speaker model, speaker identification may be disabled in this build")
+VOSK_CHECK_NEW(AudioFile, "Failed to open the audio file")
+VOSK_CHECK_NEW(SearchIndex, "Failed to open the index")
 
 %extend Model {
     Model(const char *acmodel_path, const char *langmodel_path, const char *config_file_path)  {
@@ -75,6 +367,12 @@ typedef struct {} KaldiRecognizer;
     int GetSampleFrequecy(){
         return vosk_get_sample_frequency($self);
     }
+    const char* GetCacheStats() {
+        return vosk_model_get_cache_stats($self);
+    }
+    const char* GetMemoryUsage() {
+        return vosk_model_get_memory_usage($self);
+    }
     ~Model() {
         vosk_model_free($self);
     }
@@ -104,6 +402,17 @@ typedef struct {} KaldiRecognizer;
     bool AcceptWaveform(const char *data, int len) {
         return vosk_recognizer_accept_waveform($self, data, len);
     }
+    /* Pointers to pinned or native memory: bytes of 16-bit PCM, 16-bit
+       samples and float samples, len counts the elements */
+    bool AcceptWaveformPtr(const void *ptr, int len) {
+        return vosk_recognizer_accept_waveform($self, (const char *)ptr, len);
+    }
+    bool AcceptWaveformShortPtr(const void *ptr, int len) {
+        return vosk_recognizer_accept_waveform_s($self, (const short *)ptr, len);
+    }
+    bool AcceptWaveformFloatPtr(const void *ptr, int len) {
+        return vosk_recognizer_accept_waveform_f($self, (const float *)ptr, len);
+    }
     bool AcceptWaveform(const short *sdata, int len) {
         return vosk_recognizer_accept_waveform_s($self, sdata, len);
     }
@@ -111,8 +420,19 @@ typedef struct {} KaldiRecognizer;
         return vosk_recognizer_accept_waveform_f($self, fdata, len);
     }
 #elif SWIGJAVA
-    bool AcceptWaveform(const char *data, int len) {
-        return vosk_recognizer_accept_waveform($self, data, len);
+    bool AcceptWaveformCritical(const char *critical, int len) {
+        return vosk_recognizer_accept_waveform($self, critical, len);
+    }
+    bool AcceptWaveformCritical(const short *critical, int len) {
+        return vosk_recognizer_accept_waveform_s($self, critical, len);
+    }
+    bool AcceptWaveformCritical(const float *critical, int len) {
+        return vosk_recognizer_accept_waveform_f($self, critical, len);
+    }
+    bool AcceptWaveformDirect(const char *direct, int offset, int len, int sample_size) {
+        if (sample_size == 2)
+            return vosk_recognizer_accept_waveform_s($self, (const short *)(direct + offset), len);
+        return vosk_recognizer_accept_waveform($self, direct + offset, len);
     }
 #elif SWIGJAVASCRIPT
     bool AcceptWaveform(SWIG_Object ptr) {
@@ -120,6 +440,51 @@ typedef struct {} KaldiRecognizer;
         size_t length = node::Buffer::Length(ptr);
         return vosk_recognizer_accept_waveform($self, data, length);
     }
+    /* Asynchronous versions run on the libuv thread pool and call
+       callback(err, result) on the main thread. Only one call of a
+       recognizer may be in flight, any other call throws until the
+       callback runs, index.js serializes them. */
+    void AcceptWaveformAsync(VoskJsObject self_object, SWIG_Object ptr, SWIG_Object callback) {
+        VoskAsyncQueue($self, self_object, VOSK_ASYNC_ACCEPT, ptr, callback);
+    }
+    void ResultAsync(VoskJsObject self_object, SWIG_Object callback) {
+        VoskAsyncQueue($self, self_object, VOSK_ASYNC_RESULT, v8::Local<v8::Value>(), callback);
+    }
+    void FinalResultAsync(VoskJsObject self_object, SWIG_Object callback) {
+        VoskAsyncQueue($self, self_object, VOSK_ASYNC_FINAL_RESULT, v8::Local<v8::Value>(), callback);
+    }
+#elif SWIGPYTHON
+    /* Accepts any buffer-protocol object in place: bytes of 16-bit PCM or
+       int16 and float32 arrays like numpy, array.array or memoryview.
+       Float samples are expected in 16-bit range as in the C API. */
+    int AcceptWaveform(PyObject *data) {
+        Py_buffer view;
+        if (PyObject_GetBuffer(data, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0)
+            return 0;
+
+        const char *format = view.format ? view.format : "B";
+        if (*format == '@' || *format == '=' || *format == '<')
+            format++;
+
+        int result = 0;
+        if (view.itemsize == 1 && *format && strchr("Bbc", *format) && format[1] == 0) {
+            Py_BEGIN_ALLOW_THREADS
+            result = vosk_recognizer_accept_waveform($self, (const char *)view.buf, view.len);
+            Py_END_ALLOW_THREADS
+        } else if (view.itemsize == 2 && strcmp(format, "h") == 0) {
+            Py_BEGIN_ALLOW_THREADS
+            result = vosk_recognizer_accept_waveform_s($self, (const short *)view.buf, view.len / 2);
+            Py_END_ALLOW_THREADS
+        } else if (view.itemsize == 4 && strcmp(format, "f") == 0) {
+            Py_BEGIN_ALLOW_THREADS
+            result = vosk_recognizer_accept_waveform_f($self, (const float *)view.buf, view.len / 4);
+            Py_END_ALLOW_THREADS
+        } else {
+            PyErr_Format(PyExc_TypeError, "AcceptWaveform expects bytes, int16 or float32 data, got format '%s'", format);
+        }
+        PyBuffer_Release(&view);
+        return result;
+    }
 #else
     int AcceptWaveform(const char *data, int len) {
         return vosk_recognizer_accept_waveform($self, data, len);
@@ -139,10 +504,114 @@ typedef struct {} KaldiRecognizer;
         return vosk_recognizer_get_metadata($self);
     }
 
+    int AcceptAudioFile(AudioFile *file) {
+        return vosk_recognizer_accept_audio_file($self, file);
+    }
+    const char* TranscribeFile(const char *path) {
+        return vosk_recognizer_transcribe_file($self, path);
+    }
+    const char* TranscribeFd(int fd) {
+        return vosk_recognizer_transcribe_fd($self, fd);
+    }
+
     float uttConfidence() {
         return vosk_recognizer_uttConfidence($self);
     }
+
+    const char* GetMemoryUsage() {
+        return vosk_recognizer_get_memory_usage($self);
+    }
+
+    void SetIndex(IndexWriter *writer, const char *doc) {
+        vosk_recognizer_set_index($self, writer, doc);
+    }
+}
+
+%extend AudioFile {
+    AudioFile(const char *path, float sample_rate) {
+        return vosk_audio_file_new(path, sample_rate);
+    }
+    ~AudioFile() {
+        vosk_audio_file_free($self);
+    }
+    float SampleRate() {
+        return vosk_audio_file_sample_rate($self);
+    }
+}
+
+%extend Aligner {
+    Aligner(Model *model, float sample_rate) {
+        return vosk_aligner_new(model, sample_rate);
+    }
+    ~Aligner() {
+        vosk_aligner_free($self);
+    }
+    const char* Align(const char *text, const char *data, int len) {
+        return vosk_aligner_align($self, text, data, len);
+    }
+}
+
+%extend IndexWriter {
+    IndexWriter(float min_posterior) {
+        return vosk_index_writer_new(min_posterior);
+    }
+    ~IndexWriter() {
+        vosk_index_writer_free($self);
+    }
+    bool Save(const char *path) {
+        return vosk_index_writer_save($self, path);
+    }
+}
+
+%extend SearchIndex {
+    SearchIndex(const char *path) {
+        return vosk_index_open(path);
+    }
+    ~SearchIndex() {
+        vosk_index_free($self);
+    }
+    const char* Search(const char *query, float min_score, int max_results) {
+        return vosk_index_search($self, query, min_score, max_results);
+    }
+}
+
+%extend RecognizerWorker {
+    RecognizerWorker(KaldiRecognizer *recognizer, bool partial_results) {
+        return vosk_worker_new(recognizer, partial_results);
+    }
+    ~RecognizerWorker() {
+        vosk_worker_free($self);
+    }
+    int Fd() {
+        return vosk_worker_fd($self);
+    }
+    void Feed(const char *data, int len) {
+        vosk_worker_feed($self, data, len);
+    }
+    size_t Pending() {
+        return vosk_worker_pending($self);
+    }
+    void Finish() {
+        vosk_worker_finish($self);
+    }
+    const char* PopResult() {
+        return vosk_worker_pop_result($self);
+    }
+    bool Done() {
+        return vosk_worker_done($self);
+    }
 }
 
 %rename(SetLogLevel) vosk_set_log_level;
 void vosk_set_log_level(int level);
+
+%rename(TraceStart) vosk_trace_start;
+int vosk_trace_start(const char *path);
+%rename(TraceStop) vosk_trace_stop;
+void vosk_trace_stop(void);
+%rename(RecordStart) vosk_record_start;
+int vosk_record_start(const char *dir);
+%rename(RecordStop) vosk_record_stop;
+void vosk_record_stop(void);
+%rename(MetricsPrometheus) vosk_metrics_prometheus;
+const char *vosk_metrics_prometheus(void);
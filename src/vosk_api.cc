@@ -16,8 +16,17 @@
 #include "kaldi_recognizer.h"
 #include "model.h"
 #include "spk_model.h"
+#include "trace.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "recognizer_worker.h"
+#include "audio_file.h"
+#include "fd_reader.h"
+#include "aligner.h"
+#include "search_index.h"
 
 #include <string.h>
+#include <thread>
 
 using namespace kaldi;
 
@@ -26,6 +35,25 @@ VoskModel *vosk_model_new(const char *acmodel_path, const char *langmodel_path,
     return (VoskModel *)new Model(acmodel_path, langmodel_path, config_file_path);
 }
 
+VoskModel *vosk_model_new_from_memory(const VoskModelFile *files, int num_files)
+{
+    ModelFiles model_files;
+    for (int i = 0; i < num_files; i++) {
+        model_files.Add(files[i].name, files[i].data, files[i].size);
+    }
+    return (VoskModel *)new Model(model_files);
+}
+
+VoskModel *vosk_model_new_from_bundle(const char *data, size_t size)
+{
+    ModelFiles model_files;
+    if (!model_files.AddTar(data, size)) {
+        KALDI_WARN << "Malformed model bundle";
+        return NULL;
+    }
+    return (VoskModel *)new Model(model_files);
+}
+
 int vosk_get_sample_frequency(VoskModel *model)
 {
     return ((Model *)model)->getSampleFreq();
@@ -33,62 +61,134 @@ int vosk_get_sample_frequency(VoskModel *model)
 
 void vosk_model_free(VoskModel *model)
 {
+    if (model == NULL)
+        return;
     ((Model *)model)->Unref();
 }
 
+const char *vosk_model_get_cache_stats(VoskModel *model)
+{
+    return ((Model *)model)->GetCacheStats();
+}
+
+const char *vosk_model_get_memory_usage(VoskModel *model)
+{
+    return ((Model *)model)->GetMemoryUsage();
+}
+
 VoskSpkModel *vosk_spk_model_new(const char *model_path)
 {
+#ifdef VOSK_DISABLE_SPEAKER
+    KALDI_WARN << "Built without speaker identification, ignoring " << model_path;
+    return NULL;
+#else
     return (VoskSpkModel *)new SpkModel(model_path);
+#endif
 }
 
 void vosk_spk_model_free(VoskSpkModel *model)
 {
+    if (model == NULL)
+        return;
     ((SpkModel *)model)->Unref();
 }
 
 VoskRecognizer *vosk_recognizer_new(VoskModel *model, VoskSpkModel *spk_model, float sample_rate, bool online)
 {
-    return (VoskRecognizer *)new KaldiRecognizer((Model *)model, (SpkModel *)spk_model, sample_rate, online);
+    KaldiRecognizer *recognizer = new KaldiRecognizer((Model *)model, (SpkModel *)spk_model, sample_rate, online);
+    recognizer->recorder = Recorder::Create(sample_rate, online, NULL, spk_model != NULL);
+    return (VoskRecognizer *)recognizer;
 }
 
 VoskRecognizer *vosk_recognizer_new_grm(VoskModel *model, float sample_rate, const char *grammar, bool online)
 {
-    return (VoskRecognizer *)new KaldiRecognizer((Model *)model, sample_rate, grammar, online);
+    KaldiRecognizer *recognizer = new KaldiRecognizer((Model *)model, sample_rate, grammar, online);
+    recognizer->recorder = Recorder::Create(sample_rate, online, grammar, false);
+    return (VoskRecognizer *)recognizer;
 }
 
 int vosk_recognizer_accept_waveform(VoskRecognizer *recognizer, const char *data, int length)
 {
-    return ((KaldiRecognizer *)(recognizer))->AcceptWaveform(data, length);
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->AcceptWaveform(data, length);
+
+    int64_t start = Recorder::NowUs();
+    bool endpoint = rec->AcceptWaveform(data, length);
+    rec->recorder->Accept(RECORD_PCM16, data, length, start, endpoint);
+    return endpoint;
 }
 
 int vosk_recognizer_accept_waveform_s(VoskRecognizer *recognizer, const short *data, int length)
 {
-    return ((KaldiRecognizer *)(recognizer))->AcceptWaveform(data, length);
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->AcceptWaveform(data, length);
+
+    int64_t start = Recorder::NowUs();
+    bool endpoint = rec->AcceptWaveform(data, length);
+    rec->recorder->Accept(RECORD_SHORT, data, length, start, endpoint);
+    return endpoint;
 }
 
 int vosk_recognizer_accept_waveform_f(VoskRecognizer *recognizer, const float *data, int length)
 {
-    return ((KaldiRecognizer *)(recognizer))->AcceptWaveform(data, length);
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->AcceptWaveform(data, length);
+
+    int64_t start = Recorder::NowUs();
+    bool endpoint = rec->AcceptWaveform(data, length);
+    rec->recorder->Accept(RECORD_FLOAT, data, length, start, endpoint);
+    return endpoint;
 }
 
 const char *vosk_recognizer_result(VoskRecognizer *recognizer)
 {
-    return ((KaldiRecognizer *)recognizer)->Result();
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->Result();
+
+    int64_t start = Recorder::NowUs();
+    const char *result = rec->Result();
+    rec->recorder->Result(RECORD_RESULT, result, start);
+    return result;
 }
 
 const char *vosk_recognizer_partial_result(VoskRecognizer *recognizer)
 {
-    return ((KaldiRecognizer *)recognizer)->PartialResult();
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->PartialResult();
+
+    int64_t start = Recorder::NowUs();
+    const char *result = rec->PartialResult();
+    rec->recorder->Result(RECORD_PARTIAL_RESULT, result, start);
+    return result;
 }
 
 const char *vosk_recognizer_final_result(VoskRecognizer *recognizer)
 {
-    return ((KaldiRecognizer *)recognizer)->FinalResult();
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->FinalResult();
+
+    int64_t start = Recorder::NowUs();
+    const char *result = rec->FinalResult();
+    rec->recorder->Result(RECORD_FINAL_RESULT, result, start);
+    return result;
 }
 
 const char *vosk_recognizer_get_metadata(VoskRecognizer *recognizer)
 {
-    return ((KaldiRecognizer *)recognizer)->GetMetadata();
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (!rec->recorder)
+        return rec->GetMetadata();
+
+    int64_t start = Recorder::NowUs();
+    const char *result = rec->GetMetadata();
+    rec->recorder->Result(RECORD_METADATA, result, start);
+    return result;
 }
 
 void vosk_recognizer_free(VoskRecognizer *recognizer)
@@ -96,12 +196,233 @@ void vosk_recognizer_free(VoskRecognizer *recognizer)
     delete (KaldiRecognizer *)(recognizer);
 }
 
+VoskAudioFile *vosk_audio_file_new(const char *path, float sample_rate)
+{
+    AudioFile *file = new AudioFile();
+    if (!file->Open(path, sample_rate)) {
+        delete file;
+        return NULL;
+    }
+    return (VoskAudioFile *)file;
+}
+
+float vosk_audio_file_sample_rate(VoskAudioFile *file)
+{
+    return ((AudioFile *)file)->SampleRate();
+}
+
+int vosk_recognizer_accept_audio_file(VoskRecognizer *recognizer, VoskAudioFile *file)
+{
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    if (((AudioFile *)file)->SampleRate() != rec->SampleFrequency()) {
+        KALDI_WARN << "Audio sample rate " << ((AudioFile *)file)->SampleRate() << " doesn't match the recognizer rate " << rec->SampleFrequency();
+        return -1;
+    }
+    return ((AudioFile *)file)->Feed(recognizer);
+}
+
+void vosk_audio_file_free(VoskAudioFile *file)
+{
+    delete (AudioFile *)file;
+}
+
+VoskWorker *vosk_worker_new(VoskRecognizer *recognizer, int partial_results)
+{
+    return (VoskWorker *)new RecognizerWorker(recognizer, partial_results);
+}
+
+int vosk_worker_fd(VoskWorker *worker)
+{
+    return ((RecognizerWorker *)worker)->Fd();
+}
+
+void vosk_worker_feed(VoskWorker *worker, const char *data, int length)
+{
+    ((RecognizerWorker *)worker)->Feed(data, length);
+}
+
+size_t vosk_worker_pending(VoskWorker *worker)
+{
+    return ((RecognizerWorker *)worker)->Pending();
+}
+
+void vosk_worker_finish(VoskWorker *worker)
+{
+    ((RecognizerWorker *)worker)->Finish();
+}
+
+const char *vosk_worker_pop_result(VoskWorker *worker)
+{
+    return ((RecognizerWorker *)worker)->PopResult();
+}
+
+int vosk_worker_done(VoskWorker *worker)
+{
+    return ((RecognizerWorker *)worker)->Done();
+}
+
+void vosk_worker_free(VoskWorker *worker)
+{
+    delete (RecognizerWorker *)worker;
+}
+
+VoskAligner *vosk_aligner_new(VoskModel *model, float sample_rate)
+{
+    return (VoskAligner *)new Aligner((Model *)model, sample_rate);
+}
+
+const char *vosk_aligner_align(VoskAligner *aligner, const char *text, const char *data, int length)
+{
+    return ((Aligner *)aligner)->Align(text, data, length);
+}
+
+const char *vosk_aligner_align_s(VoskAligner *aligner, const char *text, const short *data, int length)
+{
+    return ((Aligner *)aligner)->Align(text, data, length);
+}
+
+const char *vosk_aligner_align_f(VoskAligner *aligner, const char *text, const float *data, int length)
+{
+    return ((Aligner *)aligner)->Align(text, data, length);
+}
+
+void vosk_aligner_free(VoskAligner *aligner)
+{
+    delete (Aligner *)aligner;
+}
+
+VoskIndexWriter *vosk_index_writer_new(float min_posterior)
+{
+    return (VoskIndexWriter *)new SearchIndexWriter(min_posterior);
+}
+
+void vosk_recognizer_set_index(VoskRecognizer *recognizer, VoskIndexWriter *writer, const char *doc)
+{
+    ((KaldiRecognizer *)recognizer)->SetIndex((SearchIndexWriter *)writer, doc);
+}
+
+int vosk_index_writer_save(VoskIndexWriter *writer, const char *path)
+{
+    return ((SearchIndexWriter *)writer)->Save(path);
+}
+
+void vosk_index_writer_free(VoskIndexWriter *writer)
+{
+    delete (SearchIndexWriter *)writer;
+}
+
+VoskIndex *vosk_index_open(const char *path)
+{
+    SearchIndex *index = new SearchIndex();
+    if (!index->Open(path)) {
+        delete index;
+        return NULL;
+    }
+    return (VoskIndex *)index;
+}
+
+const char *vosk_index_search(VoskIndex *index, const char *query, float min_score, int max_results)
+{
+    return ((SearchIndex *)index)->Search(query, min_score, max_results);
+}
+
+void vosk_index_free(VoskIndex *index)
+{
+    delete (SearchIndex *)index;
+}
+
 void vosk_set_log_level(int log_level)
 {
     SetVerboseLevel(log_level);
 }
 
+int vosk_trace_start(const char *path)
+{
+    return Tracer::Get().Start(path);
+}
+
+void vosk_trace_stop(void)
+{
+    Tracer::Get().Stop();
+}
+
+int vosk_record_start(const char *dir)
+{
+    return Recorder::Start(dir);
+}
+
+void vosk_record_stop(void)
+{
+    Recorder::Stop();
+}
+
+const char *vosk_metrics_prometheus(void)
+{
+    static thread_local std::string metrics;
+    metrics = Metrics::Get().Render();
+    return metrics.c_str();
+}
+
 float vosk_recognizer_uttConfidence(VoskRecognizer *recognizer)
 {
     return ((KaldiRecognizer *)recognizer)->uttConfidence;
-}
\ No newline at end of file
+}
+
+const char *vosk_recognizer_transcribe_file(VoskRecognizer *recognizer, const char *path)
+{
+    KaldiRecognizer *rec = (KaldiRecognizer *)recognizer;
+    AudioFile file;
+    if (!file.Open(path, rec->SampleFrequency()))
+        return NULL;
+    if (file.SampleRate() != rec->SampleFrequency()) {
+        KALDI_WARN << "Audio sample rate " << file.SampleRate() << " doesn't match the recognizer rate " << rec->SampleFrequency();
+        return NULL;
+    }
+
+    int endpoint;
+    while ((endpoint = file.Feed(recognizer)) >= 0) {
+        if (endpoint)
+            vosk_recognizer_result(recognizer);
+    }
+    vosk_recognizer_final_result(recognizer);
+    return vosk_recognizer_get_metadata(recognizer);
+}
+
+const char *vosk_recognizer_transcribe_fd(VoskRecognizer *recognizer, int fd)
+{
+    FdReader reader(recognizer, ((KaldiRecognizer *)recognizer)->SampleFrequency(), fd, VOSK_FORMAT_AUTO, NULL, NULL, false);
+    if (reader.Run() < 0)
+        return NULL;
+    return vosk_recognizer_get_metadata(recognizer);
+}
+
+int vosk_recognizer_accept_fd(VoskRecognizer *recognizer, int fd, VoskAudioFormat format,
+                              VoskResultCallback callback, void *user_data, int flags)
+{
+    FdReader *reader = new FdReader(recognizer, ((KaldiRecognizer *)recognizer)->SampleFrequency(), fd, format,
+                                    callback, user_data, flags & VOSK_ACCEPT_FD_PARTIAL);
+    if (!(flags & VOSK_ACCEPT_FD_THREAD)) {
+        int status = reader->Run();
+        delete reader;
+        return status;
+    }
+
+    std::thread([reader, callback, user_data] {
+        try {
+            reader->Run();
+        } catch (const std::exception &e) {
+            // The caller waits for the final result before reusing the
+            // recognizer, so it is delivered even if decoding failed
+            KALDI_WARN << "Audio reader failed: " << e.what();
+            if (callback)
+                callback(user_data, VOSK_RESULT_FINAL, "{\"text\": \"\"}");
+        }
+        delete reader;
+    }).detach();
+    return 0;
+}
+
+const char *vosk_recognizer_get_memory_usage(VoskRecognizer *recognizer)
+{
+    return ((KaldiRecognizer *)recognizer)->GetMemoryUsage();
+}
@@ -17,6 +17,7 @@
 #ifndef _VOSK_API_H_
 #define _VOSK_API_H_
 
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -42,6 +43,54 @@ typedef struct VoskSpkModel VoskSpkModel;
 typedef struct VoskRecognizer VoskRecognizer;
 
 
+/** Audio file mapped into memory and fed to a recognizer without copies */
+typedef struct VoskAudioFile VoskAudioFile;
+
+
+/** Worker decodes the audio of a recognizer in a background thread.
+ *  Audio is queued without blocking and results are signaled on a file
+ *  descriptor, so a single event loop can drive many recognizers. */
+typedef struct VoskWorker VoskWorker;
+
+
+/** Aligner finds word and phone timings of audio with a known transcript */
+typedef struct VoskAligner VoskAligner;
+
+
+/** Index writer collects word posteriors of decoded utterances for spoken
+ *  term search, it is shared by any number of recognizers */
+typedef struct VoskIndexWriter VoskIndexWriter;
+
+
+/** Search index file mapped into memory */
+typedef struct VoskIndex VoskIndex;
+
+
+/** Sample format of audio read from a file descriptor */
+typedef enum {
+    VOSK_FORMAT_AUTO,    /* WAV of 16-bit mono PCM or raw 16-bit samples */
+    VOSK_FORMAT_S16LE,   /* raw 16-bit little-endian samples */
+    VOSK_FORMAT_F32LE    /* raw float samples in range -1..1 */
+} VoskAudioFormat;
+
+
+/** Type of a result delivered to a callback */
+typedef enum {
+    VOSK_RESULT_PARTIAL,    /* partial result of the current utterance */
+    VOSK_RESULT_UTTERANCE,  /* result of a finished utterance */
+    VOSK_RESULT_FINAL       /* final result at the end of input, always last */
+} VoskResultType;
+
+
+/** Receives results in JSON format, the string is valid during the call only */
+typedef void (*VoskResultCallback)(void *user_data, VoskResultType type, const char *result);
+
+
+/** Flags of vosk_recognizer_accept_fd */
+#define VOSK_ACCEPT_FD_THREAD  1   /* read on a dedicated thread and return immediately */
+#define VOSK_ACCEPT_FD_PARTIAL 2   /* deliver partial results */
+
+
 /** Loads model data from the file and returns the model object
  *
  * @param model_path: the path of the model on the filesystem
@@ -49,6 +98,39 @@ typedef struct VoskRecognizer VoskRecognizer;
 VoskModel *vosk_model_new(const char *acmodel_path, const char *langmodel_path, const char *config_file_path);
 
 
+/** Model file held in memory */
+typedef struct {
+    const char *name;  /* path in the model layout, "am/final.mdl", "am/conf/online.conf", "graph/HCLG.fst", ... */
+    const char *data;
+    size_t size;
+} VoskModelFile;
+
+
+/** Loads the model from files in memory, the filesystem is not accessed
+ *
+ *  The acoustic model files go under "am/" and the graph files under
+ *  "graph/" as in the usual model layout, their names must match the
+ *  layout exactly. Paths inside the configs, for example the i-vector
+ *  extractor files referenced from online.conf, resolve to the file
+ *  sharing the longest trailing part of the path.
+ *  The data is parsed in place, the buffers only need to stay valid
+ *  during the call.
+ *
+ *  @param files: model files
+ *  @param num_files: number of files
+ *  @returns model object */
+VoskModel *vosk_model_new_from_memory(const VoskModelFile *files, int num_files);
+
+
+/** Loads the model from a tar archive in memory, see vosk_model_new_from_memory
+ *
+ *  The archive holds the "am" and "graph" directories, possibly under a
+ *  common top directory, for example made with "tar cf model.tar am graph".
+ *
+ *  @returns model object or NULL if the archive is malformed */
+VoskModel *vosk_model_new_from_bundle(const char *data, size_t size);
+
+
 /** return the sample frequence defined in the config file
  * @param model_path: the path of the model on the filesystem
  @ @return sample_frequency_ variable */
@@ -59,14 +141,41 @@ int vosk_get_sample_frequency(VoskModel *model);
  *
  *  The model object is reference-counted so if some recognizer
  *  depends on this model, model might still stay alive. When
- *  last recognizer is released, model will be released too. */
+ *  last recognizer is released, model will be released too.
+ *  NULL is ignored. */
 void vosk_model_free(VoskModel *model);
 
 
+/** Returns the memory owned by the model components
+ *
+ *  The estimate is computed on the first call, which walks the decoding
+ *  graph and takes a while for large models, later calls are immediate.
+ *
+ *  @returns JSON object with the estimated size in bytes of the neural
+ *           network, the decoding graph, the rescoring G and CARPA, the
+ *           word symbols and their total */
+const char *vosk_model_get_memory_usage(VoskModel *model);
+
+
+/** Returns the statistics of the fingerprint cache
+ *
+ *  The cache is enabled with --fingerprint-cache.enabled=true in the model
+ *  config. Audio blocks matching recently decoded audio, like hold music
+ *  or recorded prompts, are not decoded again, the words decoded for the
+ *  matching audio are reported with shifted times instead.
+ *
+ *  @returns JSON object with the number of lookups and hits, the hit rate,
+ *           the reused words and the seconds of audio skipped and stored,
+ *           empty if the cache is disabled. The string is valid until the
+ *           next call of this function from the same thread */
+const char *vosk_model_get_cache_stats(VoskModel *model);
+
+
 /** Loads speaker model data from the file and returns the model object
  *
  * @param model_path: the path of the model on the filesystem
- * @returns model object */
+ * @returns model object or NULL if the library is built without speaker
+ *          identification */
 VoskSpkModel *vosk_spk_model_new(const char *model_path);
 
 
@@ -74,7 +183,8 @@ VoskSpkModel *vosk_spk_model_new(const char *model_path);
  *
  *  The model object is reference-counted so if some recognizer
  *  depends on this model, model might still stay alive. When
- *  last recognizer is released, model will be released too. */
+ *  last recognizer is released, model will be released too.
+ *  NULL is ignored. */
 void vosk_spk_model_free(VoskSpkModel *model);
 
 
@@ -201,12 +311,250 @@ const char *vosk_recognizer_get_metadata(VoskRecognizer *recognizer);
 float vosk_recognizer_uttConfidence(VoskRecognizer *recognizer);
 
 
+/** Transcribes a whole audio file in a single call
+ *
+ *  The file is read as with vosk_audio_file_new and must have the
+ *  recognizer sample rate. Decoding runs entirely in native
+ *  code, the language bindings don't hold their interpreter lock meanwhile.
+ *  Use a new recognizer for every file.
+ *
+ *  @returns JSON object with the complete text and the words of all
+ *           utterances with their times and confidences, NULL if the file
+ *           can't be read or has unsupported format */
+const char *vosk_recognizer_transcribe_file(VoskRecognizer *recognizer, const char *path);
+
+
+/** Same as above but reads the audio from a file descriptor until the end
+ *  of the input, for example from a pipe of a decoder process. Only 16-bit
+ *  mono WAV or raw data is supported. The descriptor is not closed. */
+const char *vosk_recognizer_transcribe_fd(VoskRecognizer *recognizer, int fd);
+
+
+/** Decodes audio read from a file descriptor until the end of input
+ *
+ *  The descriptor, for example a pipe from ffmpeg or sox or a socket, is
+ *  read in large blocks inside the library and the audio is fed in short
+ *  chunks as soon as it is available. Results are delivered to the
+ *  callback, the final result is delivered last in any case. The
+ *  descriptor is not closed.
+ *
+ *  With VOSK_ACCEPT_FD_THREAD the call returns immediately and decoding
+ *  runs on a new thread. The recognizer must not be used or freed until
+ *  the final result is delivered. If decoding fails on the thread, the
+ *  final result has empty text.
+ *
+ *  @param format sample format of the audio, raw data must have the
+ *                recognizer sample rate
+ *  @param callback receives the results, can be NULL
+ *  @param flags VOSK_ACCEPT_FD_THREAD and VOSK_ACCEPT_FD_PARTIAL
+ *  @returns 0 at the end of input, -1 on read error or unsupported format;
+ *           0 if the thread is started */
+int vosk_recognizer_accept_fd(VoskRecognizer *recognizer, int fd, VoskAudioFormat format,
+                              VoskResultCallback callback, void *user_data, int flags);
+
+
+/** Returns the memory owned by the recognizer
+ *
+ *  Decoder tokens are counted by walking them, the cost grows with the
+ *  utterance length, so don't call this after every chunk.
+ *
+ *  @returns JSON object with the number of buffered feature frames and
+ *           decoder tokens and the estimated size in bytes of the feature
+ *           pipeline, decoder tokens and lattice, grammar graph, metadata
+ *           and speaker features. Compose caches of the lookahead graph
+ *           and the rescoring LM are reported by their size limit */
+const char *vosk_recognizer_get_memory_usage(VoskRecognizer *recognizer);
+
+
 /** Releases recognizer object
  *
  *  Underlying model is also unreferenced and if needed released */
 void vosk_recognizer_free(VoskRecognizer *recognizer);
 
 
+/** Opens an audio file
+ *
+ *  WAV files with 8, 16, 24 or 32-bit integer or 32-bit float samples are
+ *  supported, multiple channels are mixed down to mono. Files without a
+ *  WAV header are read as raw 16-bit little-endian mono samples.
+ *
+ *  @param sample_rate the sample rate of raw files, WAV files carry their own
+ *  @returns the file object or NULL if the file can't be read or its format
+ *           or sample rate is not supported, rates from 1000 to 768000 Hz
+ *           are accepted */
+VoskAudioFile *vosk_audio_file_new(const char *path, float sample_rate);
+
+
+/** Returns the sample rate of the file, create the recognizer with it */
+float vosk_audio_file_sample_rate(VoskAudioFile *file);
+
+
+/** Feeds the next chunk of the file to the recognizer
+ *
+ *  16-bit mono data is passed to the recognizer straight from the mapped
+ *  file, other formats are converted chunk by chunk.
+ *
+ *  @returns 1 if the chunk ends an utterance and the result can be
+ *           retrieved, 0 if decoding continues, -1 once the whole file is
+ *           fed or the sample rate doesn't match the recognizer */
+int vosk_recognizer_accept_audio_file(VoskRecognizer *recognizer, VoskAudioFile *file);
+
+
+/** Releases the file */
+void vosk_audio_file_free(VoskAudioFile *file);
+
+
+/** Starts a background decoding thread for the recognizer
+ *
+ *  The recognizer must not be used directly while the worker exists and
+ *  must be freed after the worker.
+ *
+ *  @param partial_results also queue a partial result after every chunk
+ *                         which doesn't end an utterance
+ *  @returns worker object */
+VoskWorker *vosk_worker_new(VoskRecognizer *recognizer, int partial_results);
+
+
+/** Returns the descriptor which becomes readable when results are queued
+ *  or the thread takes audio from the queue
+ *
+ *  The descriptor is non-blocking, read and discard its data before
+ *  collecting results with vosk_worker_pop_result. */
+int vosk_worker_fd(VoskWorker *worker);
+
+
+/** Queues a copy of 16-bit PCM audio for decoding, doesn't block */
+void vosk_worker_feed(VoskWorker *worker, const char *data, int length);
+
+
+/** Returns the number of bytes of audio queued and not yet taken by the
+ *  thread, feeders wait on the descriptor while it is too large */
+size_t vosk_worker_pending(VoskWorker *worker);
+
+
+/** Marks the end of the audio, the final result is queued last */
+void vosk_worker_finish(VoskWorker *worker);
+
+
+/** Returns the next queued result in JSON format or NULL if there is none
+ *
+ *  The string is valid until the next call of this function */
+const char *vosk_worker_pop_result(VoskWorker *worker);
+
+
+/** Returns 1 once the final result is queued, results queued before
+ *  this call returned 1 are complete */
+int vosk_worker_done(VoskWorker *worker);
+
+
+/** Stops the thread and releases the worker, pending audio is dropped */
+void vosk_worker_free(VoskWorker *worker);
+
+
+/** Creates the aligner
+ *
+ *  Alignment needs a model with the HCLr.fst lexicon graph and
+ *  word_boundary.int, phone names are taken from phones.txt of the
+ *  graph if it exists. The aligner is reused for any number of
+ *  utterances, batches run one aligner per thread over a shared model.
+ *  Beams are set with the align.beam, align.retry-beam, align.lattice-beam
+ *  and align.max-active options of the model config.
+ *
+ *  @param sample_rate The sample rate of the audio you going to feed
+ *  @returns aligner object */
+VoskAligner *vosk_aligner_new(VoskModel *model, float sample_rate);
+
+
+/** Aligns an utterance of 16-bit PCM audio to its transcript
+ *
+ *  Words are separated by whitespace, words missing in the vocabulary are
+ *  aligned as the unknown word if the model has one. The result has the
+ *  words with their start and end times in seconds and the phones of
+ *  each word with their times:
+ *
+ *  {"text": "one two", "words": [{"word": "one", "start": 0.51, "end": 0.81,
+ *   "phones": [{"phone": "w", "start": 0.51, "end": 0.6}, ...]}, ...]}
+ *
+ *  @param text the transcript
+ *  @param data audio data in PCM 16-bit mono format
+ *  @param length length of the audio data
+ *  @returns the result in JSON format or NULL if the audio can't be aligned
+ *           to the text. The string is valid until the next call on the aligner */
+const char *vosk_aligner_align(VoskAligner *aligner, const char *text, const char *data, int length);
+
+
+/** Same as above but the version with the short data for language bindings where you have
+ *  audio as array of shorts */
+const char *vosk_aligner_align_s(VoskAligner *aligner, const char *text, const short *data, int length);
+
+
+/** Same as above but the version with the float data for language bindings where you have
+ *  audio as array of floats */
+const char *vosk_aligner_align_f(VoskAligner *aligner, const char *text, const float *data, int length);
+
+
+/** Releases the aligner */
+void vosk_aligner_free(VoskAligner *aligner);
+
+
+/** Creates the index writer
+ *
+ *  Postings are kept in memory until the index is saved, large archives
+ *  are split into several indices searched one by one.
+ *
+ *  @param min_posterior words of the confusion networks with a lower
+ *                       posterior probability are not indexed, 0.05 keeps
+ *                       most useful alternatives of the best path
+ *  @returns index writer object */
+VoskIndexWriter *vosk_index_writer_new(float min_posterior);
+
+
+/** Adds the words of the following results of the recognizer to the index
+ *
+ *  Every word of the lattice confusion network is added with its posterior
+ *  probability and times, so terms misrecognized in the best path are
+ *  still found. The writer must outlive the recognizer.
+ *
+ *  @param writer the index writer or NULL to stop indexing
+ *  @param doc the document name reported by searches, usually the audio file */
+void vosk_recognizer_set_index(VoskRecognizer *recognizer, VoskIndexWriter *writer, const char *doc);
+
+
+/** Writes the index file
+ *
+ *  @returns 1 on success, 0 if the file can't be written */
+int vosk_index_writer_save(VoskIndexWriter *writer, const char *path);
+
+
+/** Releases the writer */
+void vosk_index_writer_free(VoskIndexWriter *writer);
+
+
+/** Opens an index file written by vosk_index_writer_save
+ *
+ *  @returns index object or NULL if the file can't be read or is invalid */
+VoskIndex *vosk_index_open(const char *path);
+
+
+/** Searches the index for a word or a phrase
+ *
+ *  Phrase words must follow each other in the same document with pauses
+ *  of at most 0.5 seconds, the score of a match is the product of the word
+ *  posteriors. The result lists the matches ordered by score:
+ *
+ *  {"query": "hello world", "results": [{"doc": "a.wav", "start": 1.2,
+ *   "end": 1.95, "score": 0.81}, ...]}
+ *
+ *  @param min_score matches with a lower score are skipped
+ *  @param max_results maximum number of matches, 0 for all
+ *  @returns the result in JSON format, valid until the next search on the index */
+const char *vosk_index_search(VoskIndex *index, const char *query, float min_score, int max_results);
+
+
+/** Releases the index */
+void vosk_index_free(VoskIndex *index);
+
+
 /** Set log level for Kaldi messages
  *
  *  @param log_level the level
@@ -217,6 +565,48 @@ void vosk_recognizer_free(VoskRecognizer *recognizer);
 void vosk_set_log_level(int log_level);
 
 
+/** Starts tracing of the decoding pipeline
+ *
+ *  Spans of all recognizers (feature extraction, decoding, endpointing and
+ *  result computation steps) are written to the file in Chrome trace-event
+ *  format. The file can be loaded in chrome://tracing or ui.perfetto.dev.
+ *
+ *  @param path the trace file to write
+ *  @returns 1 on success, 0 if tracing is already active or file can't be opened */
+int vosk_trace_start(const char *path);
+
+
+/** Stops tracing and finalizes the trace file */
+void vosk_trace_stop(void);
+
+
+/** Starts recording recognizer traffic
+ *
+ *  Every recognizer created after this call writes the audio it accepts,
+ *  the sequence of API calls with their results and wall-clock timings to
+ *  its own file in the directory. The files can be re-driven against any
+ *  build with the vosk_replay tool.
+ *
+ *  @param dir existing directory for the recordings
+ *  @returns 1 on success, 0 if the directory doesn't exist */
+int vosk_record_start(const char *dir);
+
+
+/** Stops recording, recognizers created before keep recording until they are freed */
+void vosk_record_stop(void);
+
+
+/** Returns process-wide decoder metrics
+ *
+ *  Active recognizers, loaded models and their data size, decoded audio
+ *  duration, endpoint counts and histograms of utterance real-time factor,
+ *  finalization latency and rescoring time.
+ *
+ *  @returns metrics in Prometheus text exposition format. The string is valid
+ *           until the next call of this function from the same thread */
+const char *vosk_metrics_prometheus(void);
+
+
 #ifdef __cplusplus
 }
 #endif